@@ -0,0 +1,447 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HttpRpcClient.h
+ * JSON-RPC to the node over one kept-alive HTTP/1.1 connection, for farm mode.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+#include <json/json.h>
+#include <jsonrpccpp/client.h>
+
+/**
+ * @brief Calls JSON-RPC methods on a node over a single HTTP/1.1 connection
+ * that stays open between calls, and can send several calls as one batch.
+ *
+ * Calls block the calling thread until the response arrives or the timeout
+ * passes. A connection that fails or times out is closed and the next call
+ * opens a new one; a request that finds the kept-alive connection closed by
+ * the node is sent once more on a fresh connection. Failures throw
+ * jsonrpc::JsonRpcException, as jsonrpc::HttpClient does.
+ *
+ * Only cancelPoll() may be called from another thread.
+ */
+class HttpRpcClient
+{
+public:
+	/// A method name and its parameters.
+	typedef std::pair<std::string, Json::Value> Call;
+
+	/// Time allowed for a call, including connecting.
+	static const unsigned c_timeout = 10000;
+
+	explicit HttpRpcClient(std::string const& _url):
+		m_url(_url), m_resolver(m_io), m_socket(m_io), m_deadline(m_io), m_cancelPoll(false)
+	{
+		m_deadline.expires_at(boost::posix_time::pos_infin);
+		checkDeadline();
+	}
+
+	/// @returns the result of @a _method; throws if the node answers with an error.
+	Json::Value call(std::string const& _method, Json::Value const& _params = Json::Value(Json::arrayValue))
+	{
+		Json::Value response;
+		if (!exchange(request(Call(_method, _params), 0), c_timeout, response))
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Timed out waiting for " + m_url);
+		return result(response);
+	}
+
+	/**
+	 * @brief Sends @a _calls in one JSON-RPC batch request. Once the node has
+	 * refused a batch, this and every later batch are sent call by call.
+	 * @returns the responses in the order of the calls, each with either a
+	 * "result" or an "error" member; pass them to result() to unwrap them.
+	 */
+	std::vector<Json::Value> batch(std::vector<Call> const& _calls)
+	{
+		if (!m_batches)
+			return oneByOne(_calls);
+		Json::Value requests(Json::arrayValue);
+		for (unsigned i = 0; i < _calls.size(); ++i)
+			requests.append(request(_calls[i], i));
+		Json::Value responses;
+		if (!exchange(requests, c_timeout, responses))
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Timed out waiting for " + m_url);
+		if (!responses.isArray())
+		{
+			// Nodes that don't take batches answer with a single error.
+			m_batches = false;
+			return oneByOne(_calls);
+		}
+
+		std::vector<Json::Value> ordered(_calls.size());
+		for (auto const& r: responses)
+		{
+			Json::Value id = r.get("id", Json::Value::null);
+			if (id.isIntegral() && id.asUInt() < _calls.size())
+				ordered[id.asUInt()] = r;
+		}
+		for (auto& r: ordered)
+			if (r.isNull())
+			{
+				r["error"]["code"] = jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE;
+				r["error"]["message"] = "No response to this call in the batch";
+			}
+		return ordered;
+	}
+
+	/**
+	 * @brief Calls @a _method and waits up to @a _timeoutMs for the answer, for
+	 * methods the node holds until it has something new to say.
+	 * @returns false if the wait timed out or was cancelled; the connection is
+	 * closed then, as an HTTP request can't be withdrawn otherwise.
+	 */
+	bool poll(std::string const& _method, unsigned _timeoutMs, Json::Value& o_result)
+	{
+		if (m_cancelPoll.exchange(false))
+			return false;
+		m_polling = true;
+		Json::Value response;
+		bool answered;
+		try
+		{
+			answered = exchange(request(Call(_method, Json::Value(Json::arrayValue)), 0), _timeoutMs, response);
+		}
+		catch (...)
+		{
+			m_polling = false;
+			throw;
+		}
+		m_polling = false;
+		if (answered)
+			o_result = result(response);
+		return answered;
+	}
+
+	/// Makes a poll() in progress, or the next one, return false at once.
+	void cancelPoll()
+	{
+		m_cancelPoll = true;
+		m_io.post([this]()
+		{
+			// Runs on the thread that calls poll(); a cancel that comes between
+			// polls is left for the next one to pick up.
+			if (m_polling && m_cancelPoll.exchange(false))
+			{
+				m_aborted = true;
+				close();
+			}
+		});
+	}
+
+	/// @returns the result of a response from batch(); throws if it holds an error.
+	static Json::Value result(Json::Value const& _response)
+	{
+		Json::Value error = _response.get("error", Json::Value::null);
+		if (!error.isNull())
+		{
+			int code = error.get("code", 0).isInt() ? error.get("code", 0).asInt() : jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE;
+			std::string message = error.get("message", "").isString() ? error.get("message", "").asString() : error.toStyledString();
+			throw jsonrpc::JsonRpcException(code, message);
+		}
+		if (!_response.isMember("result"))
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, _response.toStyledString());
+		return _response["result"];
+	}
+
+private:
+	std::vector<Json::Value> oneByOne(std::vector<Call> const& _calls)
+	{
+		std::vector<Json::Value> responses(_calls.size());
+		for (unsigned i = 0; i < _calls.size(); ++i)
+			if (!exchange(request(_calls[i], 0), c_timeout, responses[i]))
+				throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Timed out waiting for " + m_url);
+		return responses;
+	}
+
+	static Json::Value request(Call const& _call, unsigned _id)
+	{
+		Json::Value r;
+		r["jsonrpc"] = "2.0";
+		r["id"] = _id;
+		r["method"] = _call.first;
+		r["params"] = _call.second;
+		return r;
+	}
+
+	[[noreturn]] void fail(std::string const& _what)
+	{
+		close();
+		throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, _what + " (" + m_url + ")");
+	}
+
+	void close()
+	{
+		boost::system::error_code ec;
+		m_resolver.cancel();
+		m_socket.close(ec);
+		m_buffer.consume(m_buffer.size());
+	}
+
+	/// The deadline actor of Boost's blocking client example: closes the socket once the deadline passes.
+	void checkDeadline()
+	{
+		if (m_deadline.expires_at() <= boost::asio::deadline_timer::traits_type::now())
+		{
+			m_aborted = true;
+			close();
+			m_deadline.expires_at(boost::posix_time::pos_infin);
+		}
+		m_deadline.async_wait([this](boost::system::error_code const&) { checkDeadline(); });
+	}
+
+	/// Runs the io_service on this thread until @a _ec is set by a completion handler.
+	void await(boost::system::error_code const& _ec)
+	{
+		while (_ec == boost::asio::error::would_block)
+			m_io.run_one();
+	}
+
+	/// @returns false if the deadline passed or a poll was cancelled meanwhile.
+	bool connect()
+	{
+		std::string url = m_url;
+		if (url.compare(0, 7, "http://") == 0)
+			url = url.substr(7);
+		else if (url.find("://") != std::string::npos)
+			fail("Only http:// node URLs are supported");
+		auto slash = url.find('/');
+		m_path = slash == std::string::npos ? "/" : url.substr(slash);
+		m_host = url.substr(0, slash);
+		std::string host = m_host;
+		std::string port = "80";
+		auto colon = host.rfind(':');
+		if (colon != std::string::npos && host.find(']', colon) == std::string::npos)
+		{
+			port = host.substr(colon + 1);
+			host = host.substr(0, colon);
+		}
+		if (host.size() > 1 && host.front() == '[' && host.back() == ']')
+			host = host.substr(1, host.size() - 2);
+
+		boost::system::error_code ec = boost::asio::error::would_block;
+		boost::asio::ip::tcp::resolver::iterator endpoints;
+		m_resolver.async_resolve(boost::asio::ip::tcp::resolver::query(host, port), [&](boost::system::error_code const& _ec, boost::asio::ip::tcp::resolver::iterator _i)
+		{
+			ec = _ec;
+			endpoints = _i;
+		});
+		await(ec);
+		if (m_aborted)
+			return false;
+		if (ec)
+			fail("Can't resolve the node's address");
+
+		ec = boost::asio::error::would_block;
+		boost::asio::async_connect(m_socket, endpoints, [&](boost::system::error_code const& _ec, boost::asio::ip::tcp::resolver::iterator)
+		{
+			ec = _ec;
+		});
+		await(ec);
+		if (m_aborted)
+			return false;
+		if (ec)
+			fail("Can't connect to the node");
+		m_socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+		return true;
+	}
+
+	/**
+	 * @brief Posts @a _request and reads the response into @a o_response.
+	 * @returns false if the deadline passed or a poll was cancelled.
+	 */
+	bool exchange(Json::Value const& _request, unsigned _timeoutMs, Json::Value& o_response)
+	{
+		std::string body = Json::FastWriter().write(_request);
+		m_aborted = false;
+		m_deadline.expires_from_now(boost::posix_time::milliseconds(_timeoutMs));
+
+		std::string response;
+		for (unsigned attempt = 0;; ++attempt)
+		{
+			bool reused = m_socket.is_open();
+			if (!reused && !connect())
+				break;
+			std::string header =
+				"POST " + m_path + " HTTP/1.1\r\n"
+				"Host: " + m_host + "\r\n"
+				"Content-Type: application/json\r\n"
+				"Content-Length: " + std::to_string(body.size()) + "\r\n"
+				"Connection: keep-alive\r\n\r\n";
+			std::vector<boost::asio::const_buffer> buffers{boost::asio::buffer(header), boost::asio::buffer(body)};
+			boost::system::error_code ec = boost::asio::error::would_block;
+			boost::asio::async_write(m_socket, buffers, [&](boost::system::error_code const& _ec, std::size_t) { ec = _ec; });
+			await(ec);
+			if (!ec)
+				ec = readUntil("\r\n\r\n");
+			if (m_aborted)
+				break;
+			if (ec)
+			{
+				close();
+				// The node may close an idle connection just as we reuse it.
+				if (reused && !attempt)
+					continue;
+				fail("Lost the connection to the node");
+			}
+			response = readBody();
+			break;
+		}
+		m_deadline.expires_at(boost::posix_time::pos_infin);
+		if (m_aborted)
+		{
+			close();
+			return false;
+		}
+		if (!Json::Reader().parse(response, o_response, false) || !(o_response.isObject() || o_response.isArray()))
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, response);
+		return true;
+	}
+
+	boost::system::error_code readUntil(std::string const& _delimiter)
+	{
+		boost::system::error_code ec = boost::asio::error::would_block;
+		boost::asio::async_read_until(m_socket, m_buffer, _delimiter, [&](boost::system::error_code const& _ec, std::size_t) { ec = _ec; });
+		await(ec);
+		return ec;
+	}
+
+	/// Reads until m_buffer holds @a _size bytes, or until the node closes the connection if @a _size is 0.
+	boost::system::error_code readExactly(std::size_t _size)
+	{
+		if (_size && m_buffer.size() >= _size)
+			return boost::system::error_code();
+		boost::system::error_code ec = boost::asio::error::would_block;
+		auto done = [&](boost::system::error_code const& _ec, std::size_t) { ec = _ec; };
+		if (_size)
+			boost::asio::async_read(m_socket, m_buffer, boost::asio::transfer_exactly(_size - m_buffer.size()), done);
+		else
+			boost::asio::async_read(m_socket, m_buffer, done);
+		await(ec);
+		return ec;
+	}
+
+	/// @returns the next @a _size bytes of m_buffer, consuming them.
+	std::string take(std::size_t _size)
+	{
+		std::string s(boost::asio::buffer_cast<char const*>(m_buffer.data()), _size);
+		m_buffer.consume(_size);
+		return s;
+	}
+
+	/// Reads the rest of the response after its status line and headers.
+	std::string readBody()
+	{
+		std::string head = take(m_buffer.size());
+		auto end = head.find("\r\n\r\n") + 4;
+		// Whatever came after the headers belongs to the body.
+		m_buffer.sputn(head.data() + end, head.size() - end);
+		head.resize(end);
+
+		std::istringstream in(head);
+		std::string version;
+		unsigned status = 0;
+		in >> version >> status;
+		bool keepAlive = version == "HTTP/1.1";
+		bool chunked = false;
+		std::size_t length = 0;
+		bool hasLength = false;
+		for (std::string line; std::getline(in, line);)
+		{
+			auto colon = line.find(':');
+			if (colon == std::string::npos)
+				continue;
+			std::string name = line.substr(0, colon);
+			std::string value = line.substr(colon + 1);
+			boost::algorithm::trim(value);
+			if (boost::iequals(name, "Content-Length"))
+			{
+				length = std::strtoul(value.c_str(), nullptr, 10);
+				hasLength = true;
+			}
+			else if (boost::iequals(name, "Transfer-Encoding"))
+				chunked = boost::icontains(value, "chunked");
+			else if (boost::iequals(name, "Connection"))
+				keepAlive = boost::iequals(value, "keep-alive") || (keepAlive && !boost::iequals(value, "close"));
+		}
+
+		std::string body;
+		boost::system::error_code ec;
+		if (chunked)
+			for (;;)
+			{
+				if ((ec = readUntil("\r\n")))
+					break;
+				std::string line = take(boost::asio::buffer_size(m_buffer.data()));
+				auto crlf = line.find("\r\n");
+				m_buffer.sputn(line.data() + crlf + 2, line.size() - crlf - 2);
+				std::size_t size = std::strtoul(line.substr(0, crlf).c_str(), nullptr, 16);
+				if ((ec = readExactly(size + 2)))
+					break;
+				body += take(size);
+				m_buffer.consume(2);
+				if (!size)
+					break;
+			}
+		else if (hasLength)
+		{
+			if (!(ec = readExactly(length)))
+				body = take(length);
+		}
+		else
+		{
+			// No length given: the body ends with the connection.
+			ec = readExactly(0);
+			if (ec == boost::asio::error::eof)
+				ec = boost::system::error_code();
+			body = take(m_buffer.size());
+			keepAlive = false;
+		}
+		if (m_aborted)
+			return std::string();
+		if (ec)
+			fail("Lost the connection to the node");
+		if (!keepAlive)
+			close();
+		// Nodes answer JSON-RPC errors with a JSON body whatever the status.
+		if (status != 200 && body.find('{') == std::string::npos)
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "HTTP status " + std::to_string(status) + " from " + m_url);
+		return body;
+	}
+
+	std::string m_url;
+	std::string m_host;		///< As sent in the Host header.
+	std::string m_path;
+
+	boost::asio::io_service m_io;
+	boost::asio::ip::tcp::resolver m_resolver;
+	boost::asio::ip::tcp::socket m_socket;
+	boost::asio::streambuf m_buffer;
+	boost::asio::deadline_timer m_deadline;
+	bool m_aborted = false;		///< The deadline passed or the poll was cancelled; the socket is closed.
+	bool m_polling = false;		///< Only touched on the calling thread.
+	bool m_batches = true;		///< The node has not refused a batch yet.
+	std::atomic<bool> m_cancelPoll;
+};
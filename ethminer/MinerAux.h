@@ -44,11 +44,11 @@
 #if ETH_ETHASHCUDA
 #include <libethash-cuda/ethash_cuda_miner.h>
 #endif
-#include <jsonrpccpp/client/connectors/httpclient.h>
-#include "FarmClient.h"
+#include "HttpRpcClient.h"
+#include "WorkNotifier.h"
 #if ETH_STRATUM
 #include <libstratum/EthStratumClient.h>
-#include <libstratum/EthStratumClientV2.h>
+#include <libstratum/StratumProxy.h>
 #endif
 
 using namespace std;
@@ -77,6 +77,36 @@ inline std::string toJS(unsigned long _n)
 class MinerCLI
 {
 public:
+	/// Set from SIGINT/SIGTERM so the mining loops can shut down and print their statistics.
+	static std::atomic<bool>& interrupted()
+	{
+		static std::atomic<bool> s_interrupted(false);
+		return s_interrupted;
+	}
+
+	static void onSignal(int)
+	{
+		interrupted() = true;
+	}
+
+	static void installSignalHandlers()
+	{
+		interrupted();
+		signal(SIGINT, &MinerCLI::onSignal);
+		signal(SIGTERM, &MinerCLI::onSignal);
+	}
+
+	static void dumpSwitchLatency(Farm const& _f)
+	{
+		SwitchLatency const& l = _f.switchLatency();
+		cnote << "Job switch latency:";
+		cnote << "  parse:   " << l.parse;
+		cnote << "  dispatch:" << l.dispatch;
+		cnote << "  farm:    " << l.farm;
+		cnote << "  launch:  " << l.launch;
+		cnote << "  total:   " << l.total;
+	}
+
 	enum class OperationMode
 	{
 		None,
@@ -130,6 +160,8 @@ public:
 				cerr << "Bad " << arg << " option: " << argv[i] << endl;
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
+		else if (arg == "--farm-notify" && i + 1 < argc)
+			m_farmNotifyPath = argv[++i];
 		else if (arg == "--farm-retries" && i + 1 < argc)
 			try {
 				m_maxFarmRetries = stol(argv[++i]);
@@ -166,16 +198,9 @@ public:
 		}
 		else if ((arg == "-SC" || arg == "--stratum-client") && i + 1 < argc)
 		{
-			try {
-				m_stratumClientVersion = atoi(argv[++i]);
-				if (m_stratumClientVersion > 2) m_stratumClientVersion = 2;
-				else if (m_stratumClientVersion < 1) m_stratumClientVersion = 1;
-			}
-			catch (...)
-			{
-				cerr << "Bad " << arg << " option: " << argv[i] << endl;
-				BOOST_THROW_EXCEPTION(BadArgument());
-			}
+			// There is only one stratum client left; the option stays for old command lines.
+			if (string(argv[++i]) != "1")
+				cwarn << "Stratum client version 2 has been retired, using the only client there is";
 		}
 		else if ((arg == "-SP" || arg == "--stratum-protocol") && i + 1 < argc)
 		{
@@ -231,10 +256,114 @@ public:
 		{
 			m_fport = string(argv[++i]);
 		}
+		else if (arg == "--stratum-pool" && i + 1 < argc)
+		{
+			// [user:pass@]host:port
+			string url = argv[++i];
+			cred_t pool;
+			size_t at = url.find_last_of("@");
+			if (at != string::npos)
+			{
+				string userpass = url.substr(0, at);
+				url = url.substr(at + 1);
+				size_t p = userpass.find_first_of(":");
+				pool.user = userpass.substr(0, p);
+				if (p != string::npos)
+					pool.pass = userpass.substr(p + 1);
+			}
+			size_t p = url.find_last_of(":");
+			pool.host = url.substr(0, p);
+			if (p != string::npos)
+				pool.port = url.substr(p + 1);
+			m_extraPools.push_back(pool);
+		}
+		else if (arg == "--pool-probe" && i + 1 < argc)
+		{
+			try
+			{
+				m_poolProbe = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if ((arg == "--stratum-keepalive" || arg == "--stratum-heartbeat" || arg == "--heartbeat-deadline") && i + 1 < argc)
+		{
+			try
+			{
+				unsigned n = stol(argv[++i]);
+				if (arg == "--stratum-keepalive")
+					m_stratumKeepalive = n;
+				else if (arg == "--stratum-heartbeat")
+					m_stratumHeartbeat = n;
+				else
+					m_heartbeatDeadline = n;
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--share-rate" && i + 1 < argc)
+		{
+			try
+			{
+				m_shareRate = stod(argv[++i]);
+				if (m_shareRate < 0)
+					BOOST_THROW_EXCEPTION(BadArgument());
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--failover-standby")
+		{
+			m_failoverStandby = true;
+		}
+		else if (arg == "--proxy" && i + 1 < argc)
+		{
+			string listen = argv[++i];
+			size_t p = listen.find_last_of(":");
+			try
+			{
+				if (p != string::npos)
+					m_proxyAddress = listen.substr(0, p);
+				m_proxyPort = stol(listen.substr(p == string::npos ? 0 : p + 1));
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if ((arg == "--work-timeout") && i + 1 < argc)
 		{
 			m_worktimeout = atoi(argv[++i]);
 		}
+		else if ((arg == "-SS" || arg == "--stratum-split") && i + 2 < argc)
+		{
+			string url = argv[++i];
+			size_t p = url.find_last_of(":");
+			m_splitURL = url.substr(0, p);
+			if (p != string::npos)
+				m_splitPort = url.substr(p + 1);
+			try
+			{
+				m_splitPercent = stol(argv[++i]);
+				if (m_splitPercent == 0 || m_splitPercent >= 100)
+					throw BadArgument();
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if ((arg == "-RH" || arg == "--report-hashrate") && i + 1 < argc)
 		{
 			m_report_stratum_hashrate = true;
@@ -433,6 +562,18 @@ public:
 				}
 			}
 		}
+		else if (arg == "--watchdog" && i + 1 < argc)
+		{
+			try
+			{
+				m_watchdogTimeout = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if ((arg == "-t" || arg == "--mining-threads") && i + 1 < argc)
 		{
 			try
@@ -465,6 +606,15 @@ public:
 			exit(0);
 		}
 
+#if ETH_STRATUM
+		// The proxy does not mine, so it needs no GPUs.
+		if (mode == OperationMode::Stratum && m_proxyPort)
+		{
+			doProxy();
+			return;
+		}
+#endif
+
 		if (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed)
 		{
 #if ETH_ETHASHCL
@@ -535,20 +685,30 @@ public:
 			<< "    -F,--farm <url>  Put into mining farm mode with the work server at URL (default: http://127.0.0.1:8545)" << endl
 			<< "    -FF,-FO, --farm-failover, --stratum-failover <url> Failover getwork/stratum URL (default: disabled)" << endl
 			<< "	--farm-retries <n> Number of retries until switch to failover (default: 3)" << endl
+			<< "    --farm-notify <path> The node's IPC socket (e.g. ~/.ethereum/geth.ipc); fetch work as soon as it announces a new block, polling only while it can't be reached (default: disabled)" << endl
 #if ETH_STRATUM
 			<< "	-S, --stratum <host:port>  Put into stratum mode with the stratum server at host:port" << endl
 			<< "	-FS, --failover-stratum <host:port>  Failover stratum server at host:port" << endl
 			<< "    -O, --userpass <username.workername:password> Stratum login credentials" << endl
 			<< "    -FO, --failover-userpass <username.workername:password> Failover stratum login credentials (optional, will use normal credentials when omitted)" << endl
+			<< "    --stratum-pool <[user:pass@]host:port> Additional stratum server; may be given several times. Credentials default to the normal ones" << endl
+			<< "    --pool-probe <n> With several pools, probe the idle ones every n seconds and move to one that is consistently faster (default: 60, 0 to disable)" << endl
+			<< "    --stratum-keepalive <n> TCP keepalive after n seconds of silence; unacknowledged data also drops the connection after 2n seconds (default: 15, 0 for the system default)" << endl
+			<< "    --stratum-heartbeat <n> Send a heartbeat request after n seconds without a message from the pool (default: 15, 0 to disable)" << endl
+			<< "    --heartbeat-deadline <n> Reconnect/failover when a heartbeat gets no response in n seconds (default: 5)" << endl
+			<< "    --share-rate <n> Suggest a share difficulty to the pool that gives about n shares per minute at the measured hashrate (default: 0, leave it to the pool; -SP 0 and 2 only)" << endl
+			<< "    --failover-standby Keep the failover stratum connection logged in and receiving work, so it takes over without reconnecting" << endl
+			<< "    --proxy <[address:]port> Do not mine; serve the stratum server's jobs to other miners connecting with -SP 2 on this port" << endl
+			<< "    -SS, --stratum-split <host:port> <n> Mine with n percent of the devices on a second stratum server (same credentials and protocol)" << endl
 			<< "    --work-timeout <n> reconnect/failover after n seconds of working on the same (stratum) job. Defaults to 180. Don't set lower than max. avg. block time" << endl
-			<< "    -SC, --stratum-client <n>  Stratum client version. Defaults to 1 (async client). Use 2 to use the new synchronous client." << endl
+			<< "    -SC, --stratum-client <n>  Ignored; there is only one stratum client since version 2 was retired." << endl
 			<< "    -SP, --stratum-protocol <n> Choose which stratum protocol to use:" << endl
 			<< "        0: official stratum spec: ethpool, ethermine, coinotron, mph, nanopool (default)" << endl
 			<< "        1: eth-proxy compatible: dwarfpool, f2pool, nanopool" << endl
 			<< "        2: EthereumStratum/1.0.0: nicehash" << endl
 			<< "    -RH, --report-hashrate Report current hashrate to pool (please only enable on pools supporting this)" << endl
 			<< "    -SE, --stratum-email <s> Email address used in eth-proxy (optional)" << endl
-			<< "    --farm-recheck <n>  Leave n ms between checks for changed work (default: 500). When using stratum, use a high value (i.e. 2000) to get more stable hashrate output" << endl
+			<< "    --farm-recheck <n>  Leave n ms between checks for changed work (default: 500; unused with nodes that hold eth_awaitNewWork until the work changes). When using stratum, use a high value (i.e. 2000) to get more stable hashrate output" << endl
 #endif
 			<< endl
 			<< "Benchmarking mode:" << endl
@@ -566,6 +726,7 @@ public:
 			<< "    --opencl-device <n>  When mining using -G/--opencl use OpenCL device n (default: 0)." << endl
 			<< "    --opencl-devices <0 1 ..n> Select which OpenCL devices to mine on. Default is to use all" << endl
 			<< "    -t, --mining-threads <n> Limit number of CPU/GPU miners to n (default: use everything available on selected platform)" << endl
+			<< "    --watchdog <n> Restart a GPU that made no hashing progress for n seconds (default: 0, disabled)" << endl
 			<< "    --list-devices List the detected OpenCL/CUDA devices and exit. Should be combined with -G or -U flag" << endl
 			<< "    -L, --dag-load-mode <mode> DAG generation mode." << endl
 			<< "        parallel    - load DAG on all GPUs at the same time (default)" << endl
@@ -747,12 +908,10 @@ private:
 		(void)_m;
 		(void)_remote;
 		(void)_recheckPeriod;
-		jsonrpc::HttpClient client(m_farmURL);
-		:: FarmClient rpc(client);
-		jsonrpc::HttpClient failoverClient(m_farmFailOverURL);
-		::FarmClient rpcFailover(failoverClient);
+		HttpRpcClient rpc(m_farmURL);
+		HttpRpcClient rpcFailover(m_farmFailOverURL);
 
-		FarmClient * prpc = &rpc;
+		HttpRpcClient * prpc = &rpc;
 
 		h256 id = h256::random();
 		Farm f;
@@ -761,9 +920,39 @@ private:
 			f.start("opencl", false);
 		else if (_m == MinerType::CUDA)
 			f.start("cuda", false);
+		f.startWatchdog(m_watchdogTimeout);
+		installSignalHandlers();
 		WorkPackage current;
 		std::mutex x_current;
-		while (m_running)
+		auto setWork = [&](Json::Value const& v, std::chrono::steady_clock::time_point requested)
+		{
+			if (!v.isArray() || v.size() < 3)
+				throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, v.toStyledString());
+			auto parsed = chrono::steady_clock::now();
+			h256 hh(v[0].asString());
+			h256 newSeedHash(v[1].asString());
+
+			if (hh != current.header)
+			{
+				x_current.lock();
+				current.header = hh;
+				current.seed = newSeedHash;
+				current.boundary = h256(fromHex(v[2].asString()), h256::AlignRight);
+				current.trace.received = requested;
+				current.trace.parsed = parsed;
+				minelog << "Got work package: #" + current.header.hex().substr(0,8);
+				f.setWork(current);
+				x_current.unlock();
+			}
+		};
+		// Nodes that hold eth_awaitNewWork until the work changes hand us new
+		// blocks at once; with any other node we poll eth_getWork.
+		bool longPoll = true;
+		// Better still, the node's IPC socket tells us of each block as it comes.
+		std::unique_ptr<WorkNotifier> notifier;
+		if (!m_farmNotifyPath.empty())
+			notifier.reset(new WorkNotifier(m_farmNotifyPath));
+		while (m_running && !interrupted())
 			try
 			{
 				bool completed = false;
@@ -771,9 +960,13 @@ private:
 				f.onSolutionFound([&](Solution sol)
 				{
 					solution = sol;
-					return completed = true;
+					completed = true;
+					prpc->cancelPoll();
+					if (notifier)
+						notifier->wake();
+					return true;
 				});
-				for (unsigned i = 0; !completed; ++i)
+				for (unsigned i = 0; !completed && !interrupted(); ++i)
 				{
 					auto mp = f.miningProgress();
 					f.resetMiningProgress();
@@ -784,40 +977,64 @@ private:
 
 					auto rate = mp.rate();
 
+					// The hashrate rides along with the work request, in one round trip where the node takes batches.
+					Json::Value hashrate(Json::arrayValue);
+					hashrate.append(toJS(rate));
+					hashrate.append("0x" + id.hex());
+					auto requested = chrono::steady_clock::now();
+					auto responses = prpc->batch({HttpRpcClient::Call("eth_submitHashrate", hashrate), HttpRpcClient::Call("eth_getWork", Json::Value(Json::arrayValue))});
 					try
 					{
-						prpc->eth_submitHashrate(toJS(rate), "0x" + id.hex());
+						HttpRpcClient::result(responses[0]);
 					}
 					catch (jsonrpc::JsonRpcException const& _e)
 					{
 						cwarn << "Failed to submit hashrate.";
 						cwarn << boost::diagnostic_information(_e);
 					}
+					setWork(HttpRpcClient::result(responses[1]), requested);
 
-					Json::Value v = prpc->eth_getWork();
-					h256 hh(v[0].asString());
-					h256 newSeedHash(v[1].asString());
-
-					if (hh != current.header)
+					if (notifier && notifier->subscribed())
 					{
-						x_current.lock();
-						current.header = hh;
-						current.seed = newSeedHash;
-						current.boundary = h256(fromHex(v[2].asString()), h256::AlignRight);
-						minelog << "Got work package: #" + current.header.hex().substr(0,8);
-						f.setWork(current);
-						x_current.unlock();
+						notifier->wait(m_farmLongPollPeriod);
+						continue;
+					}
+					if (!longPoll)
+					{
+						this_thread::sleep_for(chrono::milliseconds(_recheckPeriod));
+						continue;
+					}
+					try
+					{
+						Json::Value v;
+						requested = chrono::steady_clock::now();
+						if (prpc->poll("eth_awaitNewWork", m_farmLongPollPeriod, v))
+							setWork(v, requested);
+					}
+					catch (jsonrpc::JsonRpcException const& _e)
+					{
+						if (_e.GetCode() == jsonrpc::Errors::ERROR_CLIENT_CONNECTOR)
+							throw;
+						longPoll = false;
+						cnote << "The node does not hold eth_awaitNewWork (" << _e.what() << "); checking for new work every" << _recheckPeriod << "ms";
 					}
-					this_thread::sleep_for(chrono::milliseconds(_recheckPeriod));
 				}
+				if (!completed)
+					break;
 				cnote << "Solution found; Submitting to" << _remote << "...";
 				cnote << "  Nonce:" << solution.nonce;
 				cnote << "  headerHash:" << solution.headerHash.hex();
 				cnote << "  mixHash:" << solution.mixHash.hex();
-				if (EthashAux::eval(solution.seedHash, solution.headerHash, solution.nonce).value < solution.boundary)
+				if (solution.result.value < solution.boundary)
 				{
-					bool ok = prpc->eth_submitWork("0x" + toHex(solution.nonce), "0x" + toString(solution.headerHash), "0x" + toString(solution.mixHash));
-					if (ok) {
+					Json::Value params(Json::arrayValue);
+					params.append("0x" + toHex(solution.nonce));
+					params.append("0x" + toString(solution.headerHash));
+					params.append("0x" + toString(solution.mixHash));
+					Json::Value ok = prpc->call("eth_submitWork", params);
+					if (!ok.isBool())
+						throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, ok.toStyledString());
+					if (ok.asBool()) {
 						cnote << EthLime << "B-) Submitted and accepted." << EthReset;
 						f.acceptedSolution(false);
 					}
@@ -866,10 +1083,59 @@ private:
 
 				}
 			}
+		dumpSwitchLatency(f);
 		exit(0);
 	}
 
 #if ETH_STRATUM
+	void doProxy()
+	{
+		if (!m_farmRecheckSet)
+			m_farmRecheckPeriod = m_defaultStratumFarmRecheckPeriod;
+		if (m_failoverStandby || !m_splitURL.empty())
+			cwarn << "--failover-standby and --stratum-split are ignored by --proxy";
+
+		// No sealers: the farm only keeps the upstream share counts.
+		Farm f;
+		installSignalHandlers();
+
+		// In standby the client never starts the farm; its jobs go to the proxy instead.
+		EthStratumClient client(&f, m_minerType, m_farmURL, m_port, m_user, m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email, true);
+		client.setKeepalive(m_stratumKeepalive);
+		client.setHeartbeat(m_stratumHeartbeat, m_heartbeatDeadline);
+		if (m_farmFailOverURL != "")
+		{
+			if (m_fuser != "")
+				client.setFailover(m_farmFailOverURL, m_fport, m_fuser, m_fpass);
+			else
+				client.setFailover(m_farmFailOverURL, m_fport);
+		}
+		for (auto const& pool: m_extraPools)
+			client.addPool(pool.host, pool.port, pool.user.empty() ? m_user : pool.user, pool.user.empty() ? m_pass : pool.pass);
+		if (client.pools().size() > 1)
+			client.startProbing(m_poolProbe);
+
+		// The proxy goes first on the way out, so it must not be called after that.
+		auto proxy = std::make_shared<StratumProxy>(client, m_proxyAddress, m_proxyPort);
+		std::weak_ptr<StratumProxy> weakProxy = proxy;
+		client.onWork([weakProxy](WorkPackage const& _work, string const&)
+		{
+			if (auto p = weakProxy.lock())
+				p->setWork(_work);
+		});
+
+		while (client.isRunning() && !interrupted())
+		{
+			if (client.isConnected())
+				minelog << proxy->sessions() << "miners," << proxy->forwarded() << "shares forwarded," << proxy->refused() << "refused" << f.getSolutionStats();
+			else
+				minelog << "Waiting for the stratum server...";
+			this_thread::sleep_for(chrono::milliseconds(m_farmRecheckPeriod));
+		}
+		for (size_t i = 0; i < client.pools().size(); ++i)
+			cnote << "Pool" << client.pools().at(i).host << "latency:" << client.pools().latency(i);
+	}
+
 	void doStratum()
 	{
 		map<string, Farm::SealerDescriptor> sealers;
@@ -883,102 +1149,135 @@ private:
 			m_farmRecheckPeriod = m_defaultStratumFarmRecheckPeriod;
 
 		Farm f;
-
-		// this is very ugly, but if Stratum Client V2 tunrs out to be a success, V1 will be completely removed anyway
-		if (m_stratumClientVersion == 1) {
-			EthStratumClient client(&f, m_minerType, m_farmURL, m_port, m_user, m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email);
-			if (m_farmFailOverURL != "")
+		f.startWatchdog(m_watchdogTimeout);
+		installSignalHandlers();
+
+		// With a standby pool, whichever connection is still up takes over
+		// when the active one drops; there is no login round trip. Declared
+		// ahead of the clients, whose handlers call it from the network thread.
+		std::atomic<EthStratumClient*> active(nullptr);
+		Mutex x_failover;
+		bool failoverClosed = false;	///< Set before the clients are destroyed.
+		auto failover = [&](EthStratumClient& from, EthStratumClient& to)
+		{
+			Guard l(x_failover);
+			EthStratumClient* expected = &from;
+			if (!failoverClosed && to.isConnected() && active.compare_exchange_strong(expected, &to))
 			{
-				if (m_fuser != "")
-				{
-					client.setFailover(m_farmFailOverURL, m_fport, m_fuser, m_fpass);
-				}
-				else
-				{
-					client.setFailover(m_farmFailOverURL, m_fport);
-				}
+				from.setStandby(true);
+				to.activate();
+			}
+		};
+
+		// All connections run on one network thread.
+		auto reactor = std::make_shared<StratumReactor>();
+		EthStratumClient client(&f, m_minerType, m_farmURL, m_port, m_user, m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email, false, reactor);
+		client.setKeepalive(m_stratumKeepalive);
+		client.setHeartbeat(m_stratumHeartbeat, m_heartbeatDeadline);
+		client.setShareRate(m_shareRate);
+		active = &client;
+		std::unique_ptr<EthStratumClient> standby;
+		if (m_farmFailOverURL != "" && m_failoverStandby)
+		{
+			bool own = m_fuser != "";
+			standby.reset(new EthStratumClient(&f, m_minerType, m_farmFailOverURL, m_fport, own ? m_fuser : m_user, own ? m_fpass : m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email, true, reactor));
+			standby->setKeepalive(m_stratumKeepalive);
+			standby->setHeartbeat(m_stratumHeartbeat, m_heartbeatDeadline);
+			standby->setShareRate(m_shareRate);
+		}
+		else if (m_farmFailOverURL != "")
+		{
+			if (m_fuser != "")
+			{
+				client.setFailover(m_farmFailOverURL, m_fport, m_fuser, m_fpass);
+			}
+			else
+			{
+				client.setFailover(m_farmFailOverURL, m_fport);
 			}
-			f.setSealers(sealers);
+		}
+		for (auto const& pool: m_extraPools)
+			client.addPool(pool.host, pool.port, pool.user.empty() ? m_user : pool.user, pool.user.empty() ? m_pass : pool.pass);
+		if (client.pools().size() > 1)
+			client.startProbing(m_poolProbe);
+		f.setSealers(sealers);
 
-			f.onSolutionFound([&](Solution sol)
+		if (standby)
+		{
+			client.onConnectionLost([&]() { failover(client, *standby); });
+			standby->onConnectionLost([&]() { failover(*standby, client); });
+		}
+
+		// While disconnected the client holds on to solutions itself.
+		f.onSolutionFound([&](Solution sol)
+		{
+			active.load()->submit(sol);
+			return false;
+		});
+
+		std::unique_ptr<EthStratumClient> splitClient;
+		if (!m_splitURL.empty())
+		{
+			splitClient.reset(new EthStratumClient(&f, m_minerType, m_splitURL, m_splitPort, m_user, m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email, false, reactor));
+			splitClient->setKeepalive(m_stratumKeepalive);
+			splitClient->setHeartbeat(m_stratumHeartbeat, m_heartbeatDeadline);
+			splitClient->setShareRate(m_shareRate);
+			splitClient->setWorkSource(1);
+			f.addWorkSource(0, 100 - m_splitPercent);
+			f.addWorkSource(1, m_splitPercent, [&](Solution const& sol)
 			{
-				if (client.isConnected()) {
-					client.submit(sol);
-				}
-				else {
-					cwarn << "Can't submit solution: Not connected";
-				}
+				splitClient->submit(sol);
 				return false;
 			});
+		}
 
-			while (client.isRunning())
+		while (client.isRunning() && !interrupted())
+		{
+			auto mp = f.miningProgress();
+			f.resetMiningProgress();
+			EthStratumClient* c = active.load();
+			// The split pool gets its share of the devices, so roughly that share of the hashrate.
+			if (splitClient)
 			{
-				auto mp = f.miningProgress();
-				f.resetMiningProgress();
-				if (client.isConnected())
-				{
-					if (client.current())
-					{
-						minelog << mp << f.getSolutionStats();
-					}
-					else
-					{
-						minelog << "Waiting for work package...";
-					}
-					
-					if (this->m_report_stratum_hashrate) {
-						auto rate = mp.rate();
-						client.submitHashrate(toJS(rate));
-					}
-				}
-				this_thread::sleep_for(chrono::milliseconds(m_farmRecheckPeriod));
+				c->reportHashrate(mp.rate() * (100 - m_splitPercent) / 100);
+				splitClient->reportHashrate(mp.rate() * m_splitPercent / 100);
 			}
-		}
-		else if (m_stratumClientVersion == 2) {
-			EthStratumClientV2 client(&f, m_minerType, m_farmURL, m_port, m_user, m_pass, m_maxFarmRetries, m_worktimeout, m_stratumProtocol, m_email);
-			if (m_farmFailOverURL != "")
+			else
+				c->reportHashrate(mp.rate());
+			if (c->isConnected())
 			{
-				if (m_fuser != "")
+				if (c->current())
 				{
-					client.setFailover(m_farmFailOverURL, m_fport, m_fuser, m_fpass);
+					minelog << mp << f.getSolutionStats();
 				}
 				else
 				{
-					client.setFailover(m_farmFailOverURL, m_fport);
+					minelog << "Waiting for work package...";
 				}
-			}
-			f.setSealers(sealers);
-
-			f.onSolutionFound([&](Solution sol)
-			{
-				client.submit(sol);
-				return false;
-			});
-
-			while (client.isRunning())
-			{
-				auto mp = f.miningProgress();
-				f.resetMiningProgress();
-				if (client.isConnected())
-				{
-					if (client.current())
-					{
-						minelog << mp << f.getSolutionStats();
-					}
-					else if (client.waitState() == MINER_WAIT_STATE_WORK)
-					{
-						minelog << "Waiting for work package...";
-					}
-					
-					if (this->m_report_stratum_hashrate) {
-						auto rate = mp.rate();
-						client.submitHashrate(toJS(rate));
-					}
+				
+				if (this->m_report_stratum_hashrate) {
+					auto rate = mp.rate();
+					c->submitHashrate(toJS(rate));
 				}
-				this_thread::sleep_for(chrono::milliseconds(m_farmRecheckPeriod));
 			}
+			this_thread::sleep_for(chrono::milliseconds(m_farmRecheckPeriod));
 		}
-
+		// The miners must be gone before the clients their solutions go to. Any a
+		// late job starts again only reach the no-op handlers until ~Farm.
+		f.onSolutionFound([](Solution const&) { return false; });
+		if (splitClient)
+			f.addWorkSource(1, m_splitPercent, [](Solution const&) { return false; });
+		f.stop();
+		DEV_GUARDED(x_failover)
+			failoverClosed = true;
+		for (size_t i = 0; i < client.pools().size(); ++i)
+		{
+			cnote << "Pool" << client.pools().at(i).host << "latency:" << client.pools().latency(i);
+			cnote << "Pool" << client.pools().at(i).host << "health:" << client.pools().health(i);
+		}
+		if (standby)
+			cnote << "Failover pool latency:" << standby->pools().latency(0);
+		dumpSwitchLatency(f);
 	}
 #endif
 
@@ -1007,6 +1306,7 @@ private:
 	unsigned m_numStreams = ethash_cuda_miner::c_defaultNumStreams;
 	unsigned m_cudaSchedule = 4; // sync
 #endif
+	unsigned m_watchdogTimeout = 0;
 	unsigned m_dagLoadMode = 0; // parallel
 	unsigned m_dagCreateDevice = 0;
 	/// Benchmarking params
@@ -1018,19 +1318,20 @@ private:
 	/// Farm params
 	string m_farmURL = "http://127.0.0.1:8545";
 	string m_farmFailOverURL = "";
+	string m_farmNotifyPath;
 
 
 	string m_activeFarmURL = m_farmURL;
 	unsigned m_farmRetries = 0;
 	unsigned m_maxFarmRetries = 3;
 	unsigned m_farmRecheckPeriod = 500;
+	unsigned m_farmLongPollPeriod = 5000; // longest wait for new work, so the hashrate still gets reported
 	unsigned m_defaultStratumFarmRecheckPeriod = 2000;
 	bool m_farmRecheckSet = false;
 	int m_worktimeout = 180;
 
 #if ETH_STRATUM
 	bool m_report_stratum_hashrate = false;
-	int m_stratumClientVersion = 1;
 	int m_stratumProtocol = STRATUM_PROTOCOL_STRATUM;
 	string m_user;
 	string m_pass;
@@ -1038,6 +1339,18 @@ private:
 	string m_fuser = "";
 	string m_fpass = "";
 	string m_email = "";
+	string m_splitURL;
+	string m_splitPort;
+	unsigned m_splitPercent = 0;
+	bool m_failoverStandby = false;
+	vector<cred_t> m_extraPools;
+	unsigned m_stratumKeepalive = 15;
+	unsigned m_stratumHeartbeat = 15;
+	unsigned m_heartbeatDeadline = 5;
+	unsigned m_poolProbe = 60;
+	double m_shareRate = 0;
+	string m_proxyAddress = "0.0.0.0";
+	unsigned m_proxyPort = 0;
 #endif
 	string m_fport = "";
 };
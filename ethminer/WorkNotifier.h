@@ -0,0 +1,205 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file WorkNotifier.h
+ * New-block notifications from the node's IPC socket, for farm mode.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <json/json.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/Log.h>
+
+/**
+ * @brief Subscribes to newHeads on the node's IPC socket (geth.ipc and the
+ * like) and wakes the farm loop whenever a block arrives, so it fetches the
+ * new work at once rather than at its next check.
+ *
+ * The subscription runs on a thread of its own and reconnects on its own;
+ * while it is down, subscribed() is false and the farm loop polls instead.
+ * The node is expected to end each message with a newline, as geth does.
+ * @threadsafe
+ */
+class WorkNotifier
+{
+public:
+	/// Time between attempts to reach the IPC socket.
+	static const unsigned c_reconnectDelay = 2;
+
+	explicit WorkNotifier(std::string const& _path):
+		m_path(_path), m_timer(m_io), m_subscribed(false), m_pending(false)
+	{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		m_socket.reset(new boost::asio::local::stream_protocol::socket(m_io));
+		connect();
+		m_thread = std::thread([this]()
+		{
+			dev::setThreadName("ipc");
+			m_io.run();
+		});
+#else
+		cwarn << "Polling for new work, as IPC sockets are not supported on this platform";
+#endif
+	}
+
+	~WorkNotifier()
+	{
+		m_io.stop();
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	/// @returns true while the node sends us its new blocks.
+	bool subscribed() const { return m_subscribed; }
+
+	/**
+	 * @brief Waits for a new block, a wake(), or @a _timeoutMs to pass.
+	 * @returns true unless it timed out; a block that came since the last
+	 * wait counts too.
+	 */
+	bool wait(unsigned _timeoutMs)
+	{
+		dev::UniqueGuard l(x_pending);
+		bool woken = m_cv.wait_for(l, std::chrono::milliseconds(_timeoutMs), [this]() { return m_pending; });
+		m_pending = false;
+		return woken;
+	}
+
+	/// Ends the current or next wait() at once.
+	void wake()
+	{
+		dev::Guard l(x_pending);
+		m_pending = true;
+		m_cv.notify_all();
+	}
+
+private:
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	void connect()
+	{
+		m_socket->async_connect(boost::asio::local::stream_protocol::endpoint(m_path), [this](boost::system::error_code const& _ec)
+		{
+			if (_ec)
+			{
+				if (!m_warned)
+					cwarn << "Polling for new work, as the node at" << m_path << "can't be reached:" << _ec.message();
+				m_warned = true;
+				reconnect();
+				return;
+			}
+			m_request = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"eth_subscribe\",\"params\":[\"newHeads\"]}\n";
+			boost::asio::async_write(*m_socket, boost::asio::buffer(m_request), [this](boost::system::error_code const& _ec, std::size_t)
+			{
+				if (_ec)
+					reconnect();
+			});
+			read();
+		});
+	}
+
+	void reconnect()
+	{
+		boost::system::error_code ec;
+		m_socket->close(ec);
+		m_buffer.consume(m_buffer.size());
+		if (m_subscribed)
+		{
+			m_subscribed = false;
+			cwarn << "Polling for new work, as the subscription at" << m_path << "was lost";
+		}
+		m_timer.expires_from_now(boost::posix_time::seconds(c_reconnectDelay));
+		m_timer.async_wait([this](boost::system::error_code const& _ec)
+		{
+			if (!_ec)
+				connect();
+		});
+	}
+
+	void read()
+	{
+		boost::asio::async_read_until(*m_socket, m_buffer, "\n", [this](boost::system::error_code const& _ec, std::size_t _n)
+		{
+			if (_ec)
+			{
+				reconnect();
+				return;
+			}
+			std::string line(boost::asio::buffer_cast<char const*>(m_buffer.data()), _n);
+			m_buffer.consume(_n);
+			if (!process(line))
+				return;
+			read();
+		});
+	}
+
+	/// @returns false if the node refused the subscription; then we leave it be.
+	bool process(std::string const& _line)
+	{
+		Json::Value msg;
+		if (!Json::Reader().parse(_line, msg) || !msg.isObject())
+			return true;
+		if (msg.get("method", "") == "eth_subscription")
+		{
+			if (m_subscribed)
+				wake();
+			return true;
+		}
+		if (msg.get("id", 0) != 1)
+			return true;
+		Json::Value error = msg.get("error", Json::Value::null);
+		if (!error.isNull() || !msg.get("result", Json::Value::null).isString())
+		{
+			// Nodes don't all send an error object; get() on anything else throws on this thread.
+			Json::Value message = error.isObject() ? error.get("message", Json::Value::null) : error;
+			std::string why = message.isString() ? message.asString() : error.isNull() ? "no subscription id" : "malformed error";
+			cwarn << "Polling for new work, as the node at" << m_path << "won't send new blocks:" << why;
+			boost::system::error_code ec;
+			m_socket->close(ec);
+			return false;
+		}
+		cnote << "Subscribed to new blocks at" << m_path;
+		m_subscribed = true;
+		m_warned = false;
+		// A block may have come while we were away.
+		wake();
+		return true;
+	}
+#endif
+
+	std::string m_path;
+	boost::asio::io_service m_io;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	std::unique_ptr<boost::asio::local::stream_protocol::socket> m_socket;
+#endif
+	boost::asio::deadline_timer m_timer;	///< Paces the reconnects.
+	boost::asio::streambuf m_buffer;
+	std::string m_request;
+	bool m_warned = false;				///< Only touched on m_thread.
+	std::thread m_thread;
+
+	std::atomic<bool> m_subscribed;
+	dev::Mutex x_pending;
+	std::condition_variable m_cv;
+	bool m_pending;						///< A block or a wake() came since the last wait().
+};
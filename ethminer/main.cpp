@@ -31,6 +31,7 @@ using namespace dev;
 using namespace dev::eth;
 using namespace boost::algorithm;
 
+const unsigned WorkNotifier::c_reconnectDelay;
 
 void help()
 {
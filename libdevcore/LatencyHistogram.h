@@ -0,0 +1,126 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file LatencyHistogram.h
+ * Fixed-size latency histogram with percentile queries.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include "Guards.h"
+
+namespace dev
+{
+
+/**
+ * @brief Log-linear histogram of durations in microseconds.
+ * Values below 16 us get a bucket each, above that every power of two is split
+ * into 8 buckets, so percentiles are accurate to within 12.5%.
+ * Recording never allocates.
+ * @threadsafe
+ */
+class LatencyHistogram
+{
+public:
+	void record(std::chrono::steady_clock::duration _d)
+	{
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(_d).count();
+		record(us > 0 ? uint64_t(us) : 0);
+	}
+
+	void record(uint64_t _us)
+	{
+		Guard l(x_buckets);
+		m_buckets[bucket(_us)]++;
+		m_count++;
+		m_sum += _us;
+		if (_us > m_max)
+			m_max = _us;
+	}
+
+	uint64_t count() const { Guard l(x_buckets); return m_count; }
+	uint64_t max() const { Guard l(x_buckets); return m_max; }
+	uint64_t mean() const { Guard l(x_buckets); return m_count ? m_sum / m_count : 0; }
+
+	/// @returns the upper bound of the bucket holding the given percentile (0-100), in microseconds.
+	uint64_t percentile(double _p) const
+	{
+		Guard l(x_buckets);
+		if (!m_count)
+			return 0;
+		uint64_t rank = uint64_t(_p / 100.0 * m_count + 0.5);
+		rank = rank ? rank : 1;
+		uint64_t seen = 0;
+		for (unsigned i = 0; i < c_buckets; ++i)
+			if ((seen += m_buckets[i]) >= rank)
+				return std::min(upperBound(i), m_max);
+		return m_max;
+	}
+
+	void reset()
+	{
+		Guard l(x_buckets);
+		m_buckets.fill(0);
+		m_count = m_sum = m_max = 0;
+	}
+
+private:
+	static const unsigned c_linear = 16;
+	static const unsigned c_subBuckets = 8;
+	static const unsigned c_buckets = c_linear + (64 - 4) * c_subBuckets;
+
+	static unsigned bucket(uint64_t _us)
+	{
+		if (_us < c_linear)
+			return _us;
+		unsigned e = 4;
+		while (_us >> (e + 1))
+			++e;
+		return c_linear + (e - 4) * c_subBuckets + ((_us >> (e - 3)) & (c_subBuckets - 1));
+	}
+
+	static uint64_t upperBound(unsigned _bucket)
+	{
+		if (_bucket < c_linear)
+			return _bucket;
+		unsigned e = (_bucket - c_linear) / c_subBuckets + 4;
+		uint64_t sub = (_bucket - c_linear) % c_subBuckets;
+		return ((c_subBuckets + sub + 1) << (e - 3)) - 1;
+	}
+
+	mutable Mutex x_buckets;
+	std::array<uint64_t, c_buckets> m_buckets = {};
+	uint64_t m_count = 0;
+	uint64_t m_sum = 0;
+	uint64_t m_max = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& _out, LatencyHistogram const& _h)
+{
+	auto ms = [](uint64_t _us) { return _us / 1000.0; };
+	return _out << std::fixed << std::setprecision(2)
+		<< "p50 " << ms(_h.percentile(50)) << "ms"
+		<< " p99 " << ms(_h.percentile(99)) << "ms"
+		<< " max " << ms(_h.max()) << "ms"
+		<< " (" << _h.count() << ")";
+}
+
+}
@@ -96,13 +96,16 @@ CLMiner::~CLMiner()
 	pause();
 }
 
-void CLMiner::report(uint64_t _nonce, WorkPackage const& _w)
+void CLMiner::report(uint64_t _nonce, WorkPackage const& _w, h256 const& _searched)
 {
 	assert(_nonce != 0);
-	// TODO: Why re-evaluating?
+	// The GPU only checks the upper 64 bits of the boundary, so the full
+	// result is verified here once. Downstream consumers trust Solution::result.
 	Result r = EthashAux::eval(_w.seed, _w.header, _nonce);
 	if (r.value < _w.boundary)
-		farm.submitProof(Solution{_nonce, r.mixHash, _w.header, _w.seed, _w.boundary});
+		farm.submitProof(Solution{_nonce, r.mixHash, _w.header, _w.seed, _w.boundary, r, _w.generation, _w.source});
+	else if (r.value < _searched)
+		cllog << "Solution below the new target dropped";
 	else
 		cwarn << "Invalid solution";
 }
@@ -130,6 +133,8 @@ void CLMiner::workLoop()
 	WorkPackage current;
 	current.header = h256{1u};
 	current.seed = h256{1u};
+	// The target of the batch in flight.
+	h256 searchedBoundary;
 
 	try {
 		while (true)
@@ -139,7 +144,7 @@ void CLMiner::workLoop()
 			if (current.header != w.header)
 			{
 				// New work received. Update GPU data.
-				auto localSwitchStart = std::chrono::high_resolution_clock::now();
+				auto localSwitchStart = std::chrono::steady_clock::now();
 
 				if (!w)
 				{
@@ -176,22 +181,34 @@ void CLMiner::workLoop()
 
 				// FIXME: This logic should be move out of here.
 				if (w.exSizeBits >= 0)
-					startNonce = w.startNonce | ((uint64_t)index << (64 - 4 - w.exSizeBits)); // This can support up to 16 devices.
+					startNonce = w.startNonce | ((uint64_t)nonceSegment() << (64 - 4 - w.exSizeBits)); // This can support up to 16 devices.
 				else
 					startNonce = randomNonce();
 
 				current = w;
-				auto switchEnd = std::chrono::high_resolution_clock::now();
+				acknowledgeWork(current);
+				auto switchEnd = std::chrono::steady_clock::now();
 				auto globalSwitchTime = std::chrono::duration_cast<std::chrono::milliseconds>(switchEnd - workSwitchStart).count();
 				auto localSwitchTime = std::chrono::duration_cast<std::chrono::microseconds>(switchEnd - localSwitchStart).count();
 				cllog << "Switch time" << globalSwitchTime << "ms /" << localSwitchTime << "us";
 			}
+			else if (current.boundary != w.boundary)
+			{
+				// Only the target changed: the search goes on with the next batch.
+				cllog << "New target" << w.boundary.hex();
+				const uint64_t target = (uint64_t)(u64)((u256)w.boundary >> 192);
+				assert(target > 0);
+				m_searchKernel.setArg(4, target);
+				current.boundary = w.boundary;
+			}
 
 			// Read results.
 			// TODO: could use pinned host pointer instead.
 			uint32_t results[c_maxSearchResults + 1];
 			m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results);
 
+			// The results are from the batch launched last time round, with its target.
+			h256 const searched = searchedBoundary;
 			uint64_t nonce = 0;
 			if (results[0] > 0)
 			{
@@ -201,17 +218,31 @@ void CLMiner::workLoop()
 				m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero);
 			}
 
+			if (voided(current))
+			{
+				// A clean job replaced the work since the top of the loop. No batch is
+				// launched on it any more, but what the last one found still goes to
+				// the client, whose job tracking decides whether it is worth sending.
+				if (nonce != 0)
+					report(nonce, current, searched);
+				// Forces the switch even if the clean job kept the header.
+				current.header = h256{1u};
+				continue;
+			}
+
 			// Increase start nonce for following kernel execution.
 			startNonce += m_globalWorkSize;
 
 			// Run the kernel.
 			m_searchKernel.setArg(3, startNonce);
 			m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
+			noteSearchLaunched(current);
+			searchedBoundary = current.boundary;
 
 			// Report results while the kernel is running.
 			// It takes some time because ethash must be re-evaluated on CPU.
 			if (nonce != 0)
-				report(nonce, current);
+				report(nonce, current, searched);
 
 			// Report hash count
 			addHashCount(m_globalWorkSize);
@@ -71,7 +71,7 @@ protected:
 
 private:
 	void workLoop() override;
-	void report(uint64_t _nonce, WorkPackage const& _w);
+	void report(uint64_t _nonce, WorkPackage const& _w, h256 const& _searched);
 
 	bool init(const h256& seed);
 
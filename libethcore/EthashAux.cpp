@@ -115,9 +115,22 @@ Result EthashAux::LightAllocation::compute(h256 const& _headerHash, uint64_t _no
 
 Result EthashAux::eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t _nonce) noexcept
 {
+	EthashAux& ethash = EthashAux::get();
+	CachedResult& slot = ethash.m_results[(h256::hash()(_headerHash) ^ _nonce) % c_resultCacheSize];
 	try
 	{
-		return get().light(_seedHash)->compute(_headerHash, _nonce);
+		{
+			Guard l(ethash.x_results);
+			if (slot.nonce == _nonce && slot.header == _headerHash && slot.seed == _seedHash)
+				return slot.result;
+		}
+		Result r = ethash.light(_seedHash)->compute(_headerHash, _nonce);
+		Guard l(ethash.x_results);
+		slot.seed = _seedHash;
+		slot.header = _headerHash;
+		slot.nonce = _nonce;
+		slot.result = r;
+		return r;
 	}
 	catch(...)
 	{
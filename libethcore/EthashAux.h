@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <condition_variable>
 #include <libethash/ethash.h>
 #include <libdevcore/Log.h>
@@ -32,6 +34,12 @@ namespace dev
 namespace eth
 {
 
+struct Result
+{
+	h256 value;
+	h256 mixHash;
+};
+
 struct Solution
 {
 	uint64_t nonce;
@@ -39,12 +47,9 @@ struct Solution
 	h256 headerHash;
 	h256 seedHash;
 	h256 boundary;
-};
-
-struct Result
-{
-	h256 value;
-	h256 mixHash;
+	Result result;			///< Light evaluation the miner already verified against boundary.
+	uint64_t generation;	///< Farm work generation the solution was found for.
+	unsigned source;		///< Farm work source the solution was found for.
 };
 
 class EthashAux
@@ -67,12 +72,26 @@ public:
 
 	static LightType light(h256 const& _seedHash);
 
+	/// Evaluates ethash for the given nonce; recently computed (header, nonce) pairs are served from a small cache.
 	static Result eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t  _nonce) noexcept;
 
 private:
 	EthashAux() = default;
 	static EthashAux& get();
 
+	struct CachedResult
+	{
+		h256 seed;
+		h256 header;
+		uint64_t nonce = 0;
+		Result result;
+	};
+
+	static const unsigned c_resultCacheSize = 64;
+
+	Mutex x_results;
+	std::array<CachedResult, c_resultCacheSize> m_results;
+
 	Mutex x_lights;
 	std::unordered_map<h256, LightType> m_lights;
 
@@ -81,6 +100,14 @@ private:
 	h256s m_seedHashes;
 };
 
+/// Monotonic timestamps of a work package on its way from the pool to the miners.
+struct WorkTrace
+{
+	std::chrono::steady_clock::time_point received;	///< Bytes read from the socket.
+	std::chrono::steady_clock::time_point parsed;	///< Message parsed.
+	std::chrono::steady_clock::time_point farmSet;	///< Handed to Farm::setWork().
+};
+
 struct WorkPackage
 {
 	WorkPackage() = default;
@@ -98,6 +125,10 @@ struct WorkPackage
 
 	uint64_t startNonce = 0;
 	int exSizeBits = -1;
+	bool clean = true;			///< Earlier work is void, so the miners drop what they found for it.
+	uint64_t generation = 0;	///< Stamped by Farm::setWork().
+	unsigned source = 0;		///< Farm work source, stamped by Farm::setWork().
+	WorkTrace trace;
 };
 
 }
@@ -109,9 +109,10 @@ void EthashCUDAMiner::report(uint64_t _nonce)
 {
 	// FIXME: This code is exactly the same as in EthashGPUMiner.
 	WorkPackage w = work();  // Copy work package to avoid repeated mutex lock.
+	// The GPU keeps the target it was started with; one changed by setBoundary() applies here.
 	Result r = EthashAux::eval(w.seed, w.header, _nonce);
 	if (r.value < w.boundary)
-		farm.submitProof(Solution{_nonce, r.mixHash, w.header, w.seed, w.boundary});
+		farm.submitProof(Solution{_nonce, r.mixHash, w.header, w.seed, w.boundary, r, w.generation, w.source});
 }
 
 void EthashCUDAMiner::kickOff()
@@ -185,7 +186,9 @@ void EthashCUDAMiner::workLoop()
 		uint64_t upper64OfBoundary = (uint64_t)(u64)((u256)w.boundary >> 192);
 		uint64_t startN = w.startNonce;
 		if (w.exSizeBits >= 0)
-			startN = w.startNonce | ((uint64_t)index << (64 - 4 - w.exSizeBits)); // this can support up to 16 devices
+			startN = w.startNonce | ((uint64_t)nonceSegment() << (64 - 4 - w.exSizeBits)); // this can support up to 16 devices
+		acknowledgeWork(w);
+		noteSearchLaunched(w);
 		m_miner->search(w.header.data(), upper64OfBoundary, *m_hook, (w.exSizeBits >= 0), startN);
 	}
 	catch (std::runtime_error const& _e)
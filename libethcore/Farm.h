@@ -22,9 +22,16 @@
 #pragma once
 
 #include <thread>
+#include <future>
 #include <list>
+#include <map>
 #include <atomic>
+#include <array>
+#include <set>
+#include <deque>
+#include <algorithm>
 #include <libdevcore/Common.h>
+#include <libdevcore/LatencyHistogram.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/Miner.h>
 #include <libethcore/BlockHeader.h>
@@ -35,12 +42,98 @@ namespace dev
 namespace eth
 {
 
+/**
+ * @brief Fixed-size open-addressing set of the (header, nonce) pairs submitted
+ * for the current and the previous job of each work source.
+ * Slots tagged with an older generation are treated as free, so the filter
+ * never has to be cleared on a job switch and never allocates.
+ */
+class DuplicateSolutionFilter
+{
+public:
+	/**
+	 * @brief Records a solution.
+	 * @param _oldestLive Per work source, generations below this are considered
+	 * expired. Slots of sources not listed are expired too.
+	 * @returns true if the solution was already recorded.
+	 */
+	bool check(Solution const& _s, std::map<unsigned, uint64_t> const& _oldestLive)
+	{
+		uint64_t key = h256::hash()(_s.headerHash) ^ _s.nonce;
+		unsigned home = key % c_slots;
+		unsigned freeSlot = c_slots;
+		for (unsigned i = 0; i < c_probes; ++i)
+		{
+			Slot& slot = m_slots[(home + i) % c_slots];
+			auto live = _oldestLive.find(slot.source);
+			if (!slot.generation || live == _oldestLive.end() || slot.generation < live->second)
+			{
+				if (freeSlot == c_slots)
+					freeSlot = (home + i) % c_slots;
+				continue;
+			}
+			if (slot.key == key && slot.source == _s.source)
+				return true;
+		}
+		// All probed slots in use: evict the home slot.
+		Slot& slot = m_slots[freeSlot == c_slots ? home : freeSlot];
+		slot.key = key;
+		slot.source = _s.source;
+		slot.generation = std::max<uint64_t>(_s.generation, 1);
+		return false;
+	}
+
+private:
+	static const unsigned c_slots = 256;
+	static const unsigned c_probes = 16;
+
+	struct Slot
+	{
+		uint64_t key = 0;
+		uint64_t generation = 0;
+		unsigned source = 0;	///< Work source whose generations this slot's generation counts in.
+	};
+	std::array<Slot, c_slots> m_slots;
+};
+
+/// Reported by the Farm watchdog whenever a miner is found stalled.
+struct MinerStallEvent
+{
+	unsigned index;			///< Device index of the miner.
+	std::string reason;
+	unsigned restarts;		///< Number of consecutive restarts including this one.
+	std::chrono::steady_clock::time_point time;
+};
+
+/// Job-switch latency split into the stages a work package passes through.
+struct SwitchLatency
+{
+	LatencyHistogram parse;		///< Socket read to parsed message.
+	LatencyHistogram dispatch;	///< Parsed message to Farm::setWork().
+	LatencyHistogram farm;		///< Farm::setWork() to Miner::setWork().
+	LatencyHistogram launch;	///< Miner::setWork() to the first kernel launch.
+	LatencyHistogram total;		///< Socket read (or Farm::setWork()) to the first kernel launch.
+
+	void reset() { parse.reset(); dispatch.reset(); farm.reset(); launch.reset(); total.reset(); }
+};
+
+inline std::ostream& operator<<(std::ostream& _out, SwitchLatency const& _l)
+{
+	return _out << "parse " << _l.parse << ", dispatch " << _l.dispatch << ", farm " << _l.farm
+		<< ", launch " << _l.launch << ", total " << _l.total;
+}
+
 /**
  * @brief A collective of Miners.
  * Miners ask for work, then submit proofs
+ *
+ * Work may come from several sources at once (e.g. two pools). Each source has
+ * a weight; the miners are split between the sources accordingly and solutions
+ * are handed back to the source whose work package they solve. Source 0 always
+ * exists and is the one used by the single-source API.
  * @threadsafe
  */
-class Farm: public FarmFace
+class Farm: public FarmFace, Worker
 {
 public:
 	struct SealerDescriptor
@@ -49,8 +142,17 @@ public:
 		std::function<Miner*(FarmFace&, unsigned)> create;
 	};
 
+	using SolutionFound = std::function<bool(Solution const&)>;
+	using MinerStalled = std::function<void(MinerStallEvent const&)>;
+
+	Farm(): Worker("watchdog")
+	{
+		m_sources[0] = WorkSource();
+	}
+
 	~Farm()
 	{
+		stopWorking();
 		stop();
 	}
 
@@ -58,17 +160,100 @@ public:
 	 * @brief Sets the current mining mission.
 	 * @param _wp The work package we wish to be mining.
 	 */
-	void setWork(WorkPackage const& _wp)
+	void setWork(WorkPackage const& _wp) { setWork(0, _wp); }
+
+	/**
+	 * @brief Sets the current mining mission of the miners assigned to one work source.
+	 * If only the boundary differs from the source's current work, the miners
+	 * keep searching and just take the new target.
+	 * @param _source The work source, see addWorkSource().
+	 * @param _wp The work package we wish to be mining.
+	 */
+	void setWork(unsigned _source, WorkPackage const& _wp)
 	{
 		Guard l(x_minerWork);
-		if (_wp.header == m_work.header && _wp.startNonce == m_work.startNonce)
-			return;
-		m_work = _wp;
+		WorkPackage w;
+		{
+			Guard l2(x_sources);
+			auto it = m_sources.find(_source);
+			if (it == m_sources.end())
+				return;
+			WorkSource& src = it->second;
+			if (_wp.header == src.work.header && _wp.startNonce == src.work.startNonce)
+			{
+				if (_wp.boundary == src.work.boundary)
+					return;
+				src.work.boundary = _wp.boundary;
+				for (auto const& m: m_miners)
+					if (!m_pausedMiners.count(m->minerIndex()) && minerSource(m->minerIndex()) == _source)
+						m->setBoundary(_wp.boundary);
+				return;
+			}
+			src.previousGeneration = src.work.generation;
+			src.work = _wp;
+			src.work.source = _source;
+			src.work.generation = ++m_workGeneration;
+			src.setAt = std::chrono::steady_clock::now();
+			src.work.trace.farmSet = src.setAt;
+			w = src.work;
+		}
+		if (w.trace.parsed != std::chrono::steady_clock::time_point())
+		{
+			if (w.trace.received != std::chrono::steady_clock::time_point())
+				m_switchLatency.parse.record(w.trace.parsed - w.trace.received);
+			m_switchLatency.dispatch.record(w.trace.farmSet - w.trace.parsed);
+		}
 		for (auto const& m: m_miners)
-			m->setWork(m_work);
+			if (!m_pausedMiners.count(m->minerIndex()) && minerSource(m->minerIndex()) == _source)
+				m->setWork(w);
 		resetTimer();
 	}
 
+	/**
+	 * @brief Adds (or updates) a work source.
+	 * @param _source Identifier used with setWork(); 0 is the default source.
+	 * @param _weight Share of the miners assigned to the source, relative to the other sources' weights.
+	 * @param _handler Receives the solutions for this source's work. Falls back to onSolutionFound() if empty.
+	 */
+	void addWorkSource(unsigned _source, unsigned _weight, SolutionFound const& _handler = SolutionFound())
+	{
+		Guard l(x_minerWork);
+		{
+			Guard l2(x_sources);
+			WorkSource& src = m_sources[_source];
+			src.weight = _weight;
+			src.onSolutionFound = _handler;
+		}
+		rebalanceSources();
+	}
+
+	/**
+	 * @brief Changes the weight of a work source; miners are moved between sources as needed.
+	 * A moved miner only re-uploads the header if both sources are on the same epoch.
+	 */
+	void setWorkSourceWeight(unsigned _source, unsigned _weight)
+	{
+		Guard l(x_minerWork);
+		{
+			Guard l2(x_sources);
+			auto it = m_sources.find(_source);
+			if (it == m_sources.end())
+				return;
+			it->second.weight = _weight;
+		}
+		rebalanceSources();
+	}
+
+	void removeWorkSource(unsigned _source)
+	{
+		if (!_source)
+			return;
+		Guard l(x_minerWork);
+		DEV_GUARDED(x_sources)
+			m_sources.erase(_source);
+		rebalanceSources();
+	}
+
 	void setSealers(std::map<std::string, SealerDescriptor> const& _sealers) { m_sealers = _sealers; }
 
 	/**
@@ -85,6 +270,10 @@ public:
 		if (!mixed)
 		{
 			m_miners.clear();
+			m_minerSealers.clear();
+			m_minerSources.clear();
+			m_pausedMiners.clear();
+			m_restartingMiners.clear();
 		}
 		auto ins = m_sealers[_sealer].instances();
 		unsigned start = 0;
@@ -94,14 +283,24 @@ public:
 		}
 		else
 		{
-			start = m_miners.size();
+			// Indexes freed by removeMiner() may sit below live ones, and restarting
+			// miners are not in m_miners: continue after the largest index in use.
+			start = m_minerSealers.empty() ? 0 : m_minerSealers.rbegin()->first + 1;
 			ins += start;
-			m_miners.reserve(ins);
+			m_miners.reserve(m_miners.size() + ins - start);
 		}
 		for (unsigned i = start; i < ins; ++i)
 		{
+			unsigned segment = mixed ? freeNonceSegment() : i;
+			if (mixed && segment >= c_nonceSegments)
+			{
+				cwarn << "Can't start miner" << i << ": no free nonce segment";
+				break;
+			}
 			// TODO: Improve miners creation, use unique_ptr.
 			m_miners.push_back(std::shared_ptr<Miner>(m_sealers[_sealer].create(*this, i)));
+			m_miners.back()->setNonceSegment(segment);
+			m_minerSealers[i] = _sealer;
 
 			// Start miners' threads. They should pause waiting for new work
 			// package.
@@ -109,6 +308,7 @@ public:
 		}
 		m_isMining = true;
 		m_lastSealer = _sealer;
+		rebalanceSources();
 		resetTimer();
 		return true;
 	}
@@ -119,8 +319,216 @@ public:
 	{
 		Guard l(x_minerWork);
 		m_miners.clear();
+		m_minerSealers.clear();
+		m_minerSources.clear();
+		m_pausedMiners.clear();
+		m_restartingMiners.clear();
 		m_isMining = false;
 	}
+
+	/**
+	 * @brief Creates and starts a single miner without touching the others.
+	 * @param _sealer The sealer used to create the miner.
+	 * @param _index The device index, must not be in use.
+	 * @return true if the miner was added, false if the index is taken or all
+	 * c_nonceSegments nonce segments are in use.
+	 */
+	bool addMiner(std::string const& _sealer, unsigned _index)
+	{
+		Guard l(x_minerWork);
+		if (!m_sealers.count(_sealer) || findMiner(_index) != m_miners.end() || m_restartingMiners.count(_index))
+			return false;
+
+		unsigned segment = freeNonceSegment();
+		if (segment >= c_nonceSegments)
+		{
+			cwarn << "Can't add miner" << _index << ": no free nonce segment";
+			return false;
+		}
+
+		std::shared_ptr<Miner> m(m_sealers[_sealer].create(*this, _index));
+		m->setNonceSegment(segment);
+		m->startWorking();
+		m_miners.push_back(m);
+		m_minerSealers[_index] = _sealer;
+		m_isMining = true;
+		rebalanceSources();
+		cnote << "Added miner" << _index << "(" << _sealer << ")";
+		return true;
+	}
+
+	/**
+	 * @brief Stops and destroys a single miner. The remaining miners keep mining
+	 * and keep their DAGs.
+	 */
+	bool removeMiner(unsigned _index)
+	{
+		std::shared_ptr<Miner> m;
+		{
+			Guard l(x_minerWork);
+			auto it = findMiner(_index);
+			if (it == m_miners.end())
+			{
+				// Being restarted: dropping the mark keeps restartMiner() from re-creating it.
+				if (!m_restartingMiners.erase(_index))
+					return false;
+			}
+			else
+			{
+				m = *it;
+				m_miners.erase(it);
+			}
+			m_minerSealers.erase(_index);
+			m_minerSources.erase(_index);
+			m_pausedMiners.erase(_index);
+			m_isMining = !m_miners.empty() || !m_restartingMiners.empty();
+			rebalanceSources();
+		}
+		// Destroyed outside the lock: joining the miner thread may take a while.
+		m.reset();
+		cnote << "Removed miner" << _index;
+		return true;
+	}
+
+	/**
+	 * @brief Takes a miner off the current work but keeps it and its DAG resident.
+	 */
+	bool pauseMiner(unsigned _index)
+	{
+		Guard l(x_minerWork);
+		auto it = findMiner(_index);
+		if (it == m_miners.end() || m_pausedMiners.count(_index))
+			return false;
+		m_pausedMiners.insert(_index);
+		m_minerSources.erase(_index);
+		(*it)->setWork(WorkPackage());
+		rebalanceSources();
+		cnote << "Paused miner" << _index;
+		return true;
+	}
+
+	/**
+	 * @brief Puts a paused miner back on the current work.
+	 */
+	bool resumeMiner(unsigned _index)
+	{
+		Guard l(x_minerWork);
+		auto it = findMiner(_index);
+		if (it == m_miners.end() || !m_pausedMiners.erase(_index))
+			return false;
+		rebalanceSources();
+		cnote << "Resumed miner" << _index;
+		return true;
+	}
+
+	bool isMinerPaused(unsigned _index) const
+	{
+		Guard l(x_minerWork);
+		return m_pausedMiners.count(_index) > 0;
+	}
+
+	/**
+	 * @brief Destroys a single miner and creates it again with the same sealer,
+	 * index, nonce segment and work source.
+	 *
+	 * The index is marked as restarting while the old instance is torn down without
+	 * the lock held; a stop() or removeMiner() in that window cancels the restart.
+	 * A miner hung in a driver call may never stop: after c_teardownSeconds it is
+	 * abandoned to its own thread, removed from the farm and reported as stalled.
+	 */
+	bool restartMiner(unsigned _index)
+	{
+		std::shared_ptr<Miner> old;
+		std::string sealer;
+		unsigned segment;
+		{
+			Guard l(x_minerWork);
+			auto it = findMiner(_index);
+			if (it == m_miners.end())
+				return false;
+			old = *it;
+			sealer = m_minerSealers[_index];
+			segment = old->nonceSegment();
+			m_miners.erase(it);
+			m_restartingMiners[_index] = segment;
+		}
+		// The old instance has to release the device before the new one grabs it.
+		// The teardown thread holds the only reference, so a hung miner never blocks the caller.
+		auto released = std::make_shared<std::promise<void>>();
+		std::future<void> stopped = released->get_future();
+		std::thread([](std::shared_ptr<Miner> _m, std::shared_ptr<std::promise<void>> _released) {
+			_m.reset();
+			_released->set_value();
+		}, std::move(old), released).detach();
+		bool hung = stopped.wait_for(std::chrono::seconds(c_teardownSeconds)) != std::future_status::ready;
+
+		{
+			Guard l(x_minerWork);
+			if (!m_restartingMiners.erase(_index) || !m_isMining)
+			{
+				cnote << "Restart of miner" << _index << "cancelled";
+				return false;
+			}
+			if (!hung)
+			{
+				std::shared_ptr<Miner> m(m_sealers[sealer].create(*this, _index));
+				m->setNonceSegment(segment);
+				m->startWorking();
+				if (!m_pausedMiners.count(_index))
+				{
+					WorkPackage w = sourceWork(minerSource(_index));
+					if (w)
+						m->setWork(w);
+				}
+				m_miners.push_back(m);
+				cnote << "Restarted miner" << _index;
+				return true;
+			}
+			// A new instance would fight the hung one for the device: give up on the index.
+			m_minerSealers.erase(_index);
+			m_minerSources.erase(_index);
+			m_pausedMiners.erase(_index);
+			m_isMining = !m_miners.empty() || !m_restartingMiners.empty();
+			rebalanceSources();
+		}
+		noteStall(_index, "restart failed, miner abandoned");
+		return false;
+	}
+
+	/**
+	 * @brief Starts watching every miner for hash count progress and job switch
+	 * acknowledgements. A miner that shows neither for @a _stallSeconds is restarted,
+	 * and again after an exponentially growing hold-off if it keeps stalling.
+	 */
+	void startWatchdog(unsigned _stallSeconds)
+	{
+		if (!_stallSeconds)
+			return;
+		m_stallTimeout = std::chrono::seconds(_stallSeconds);
+		startWorking();
+	}
+
+	void onMinerStalled(MinerStalled const& _handler) { Guard l(x_health); m_onMinerStalled = _handler; }
+
+	void noteSearchLaunched(WorkPackage const& _w, std::chrono::steady_clock::time_point _minerSet, std::chrono::steady_clock::time_point _launched) override
+	{
+		if (_w.trace.farmSet == std::chrono::steady_clock::time_point())
+			return;
+		m_switchLatency.farm.record(_minerSet - _w.trace.farmSet);
+		m_switchLatency.launch.record(_launched - _minerSet);
+		auto start = _w.trace.received != std::chrono::steady_clock::time_point() ? _w.trace.received : _w.trace.farmSet;
+		m_switchLatency.total.record(_launched - start);
+	}
+
+	/// @returns the job-switch latency histograms, filled by setWork() and the miners.
+	SwitchLatency const& switchLatency() const { return m_switchLatency; }
+
+	/// @returns the most recent stall events, oldest first.
+	std::vector<MinerStallEvent> minerStallEvents() const
+	{
+		Guard l(x_health);
+		return std::vector<MinerStallEvent>(m_stallEvents.begin(), m_stallEvents.end());
+	}
 	
 	bool isMining() const
 	{
@@ -142,6 +550,7 @@ public:
 				uint64_t minerHashCount = i->hashCount();
 				p.hashes += minerHashCount;
 				p.minersHashes.push_back(minerHashCount);
+				p.minersIndexes.push_back(i->minerIndex());
 			}
 		}
 		Guard l(x_progress);
@@ -190,18 +599,25 @@ public:
 		}
 	}
 
-	using SolutionFound = std::function<bool(Solution const&)>;
-
 	/**
 	 * @brief Provides a valid header based upon that received previously with setWork().
 	 * @param _bi The now-valid header.
 	 * @return true if the header was good and that the Farm should pause until more work is submitted.
 	 */
-	void onSolutionFound(SolutionFound const& _handler) { m_onSolutionFound = _handler; }
+	void onSolutionFound(SolutionFound const& _handler) { Guard l(x_sources); m_onSolutionFound = _handler; }
 
-	WorkPackage work() const { Guard l(x_minerWork); return m_work; }
+	WorkPackage work() const { return sourceWork(0); }
 
 private:
+	struct WorkSource
+	{
+		unsigned weight = 1;
+		WorkPackage work;
+		uint64_t previousGeneration = 0;
+		std::chrono::steady_clock::time_point setAt;
+		SolutionFound onSolutionFound;
+	};
+
 	/**
 	 * @brief Called from a Miner to note a WorkPackage has a solution.
 	 * @param _p The solution.
@@ -210,8 +626,30 @@ private:
 	 */
 	bool submitProof(Solution const& _s) override
 	{
-		assert(m_onSolutionFound);
-		return m_onSolutionFound(_s);
+		SolutionFound handler;
+		std::map<unsigned, uint64_t> oldestLive;
+		{
+			Guard l(x_sources);
+			handler = m_onSolutionFound;
+			auto it = m_sources.find(_s.source);
+			if (it != m_sources.end() && it->second.onSolutionFound)
+				handler = it->second.onSolutionFound;
+			for (auto const& src: m_sources)
+				oldestLive[src.first] = src.second.previousGeneration;
+		}
+		assert(handler);
+		{
+			// Mixed CL/CUDA rigs and restarts on the same job may find a nonce twice.
+			// Such shares are rejected by the pool anyway, so drop them here.
+			Guard l(x_solutions);
+			if (m_duplicates.check(_s, oldestLive))
+			{
+				m_solutionStats.duplicate();
+				cwarn << "Duplicate solution dropped; Nonce:" << "0x" + toHex(_s.nonce);
+				return false;
+			}
+		}
+		return handler(_s);
 	}
 
 	void resetTimer()
@@ -219,9 +657,227 @@ private:
 		m_lastStart = std::chrono::steady_clock::now();
 	}
 
+	WorkPackage sourceWork(unsigned _source) const
+	{
+		Guard l(x_sources);
+		auto it = m_sources.find(_source);
+		return it != m_sources.end() ? it->second.work : WorkPackage();
+	}
+
+	/// @note x_minerWork must be held.
+	unsigned minerSource(unsigned _index) const
+	{
+		auto it = m_minerSources.find(_index);
+		return it != m_minerSources.end() ? it->second : 0;
+	}
+
+	/**
+	 * @brief Splits the running miners between the work sources by weight.
+	 * Miners stay with their source as long as it is not over its share, so
+	 * adding or removing a miner or a source moves as few devices as possible.
+	 * @note x_minerWork must be held.
+	 */
+	void rebalanceSources()
+	{
+		std::vector<unsigned> indexes;
+		for (auto const& m: m_miners)
+			if (!m_pausedMiners.count(m->minerIndex()))
+				indexes.push_back(m->minerIndex());
+		std::sort(indexes.begin(), indexes.end());
+
+		std::map<unsigned, unsigned> quota;
+		std::map<unsigned, WorkPackage> works;
+		{
+			Guard l(x_sources);
+			unsigned total = 0;
+			for (auto const& s: m_sources)
+				total += s.second.weight;
+			if (!total)
+				quota[0] = indexes.size();
+			else
+			{
+				// Largest remainder apportionment.
+				unsigned assigned = 0;
+				std::vector<std::pair<uint64_t, unsigned>> remainders;
+				for (auto const& s: m_sources)
+				{
+					uint64_t share = uint64_t(indexes.size()) * s.second.weight;
+					quota[s.first] = share / total;
+					assigned += share / total;
+					remainders.emplace_back(share % total, s.first);
+				}
+				std::stable_sort(remainders.begin(), remainders.end(), [](std::pair<uint64_t, unsigned> const& _a, std::pair<uint64_t, unsigned> const& _b) { return _a.first > _b.first; });
+				for (unsigned i = 0; assigned < indexes.size(); ++i, ++assigned)
+					quota[remainders[i].second]++;
+			}
+			for (auto const& s: m_sources)
+				works[s.first] = s.second.work;
+		}
+
+		std::map<unsigned, unsigned> used;
+		std::vector<unsigned> unplaced;
+		for (unsigned index: indexes)
+		{
+			auto it = m_minerSources.find(index);
+			if (it != m_minerSources.end() && used[it->second] < quota[it->second])
+				used[it->second]++;
+			else
+				unplaced.push_back(index);
+		}
+		for (unsigned index: unplaced)
+		{
+			unsigned source = 0;
+			for (auto const& q: quota)
+				if (used[q.first] < q.second)
+				{
+					source = q.first;
+					break;
+				}
+			used[source]++;
+			m_minerSources[index] = source;
+			auto m = findMiner(index);
+			// Epochs are compared by the miners themselves: the DAG is only
+			// rebuilt if the new source works on a different seed.
+			(*m)->setWork(works[source]);
+		}
+	}
+
+	struct MinerHealth
+	{
+		uint64_t hashes = 0;
+		std::chrono::steady_clock::time_point lastProgress;
+		std::chrono::steady_clock::time_point holdOff;
+		std::chrono::steady_clock::time_point lastStall;
+		h256 seed;				///< Seed of the last acknowledged work package.
+		unsigned restarts = 0;
+	};
+
+	void workLoop() override
+	{
+		while (!shouldStop())
+		{
+			checkMiners();
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+	}
+
+	void checkMiners()
+	{
+		using namespace std::chrono;
+		auto now = steady_clock::now();
+		std::vector<std::pair<unsigned, std::string>> stalled;
+		{
+			Guard l(x_minerWork);
+			std::map<unsigned, std::pair<WorkPackage, steady_clock::time_point>> works;
+			DEV_GUARDED(x_sources)
+				for (auto const& s: m_sources)
+					works[s.first] = std::make_pair(s.second.work, s.second.setAt);
+
+			Guard l2(x_health);
+			for (auto const& m: m_miners)
+			{
+				unsigned index = m->minerIndex();
+				bool isNew = !m_health.count(index);
+				MinerHealth& h = m_health[index];
+				WorkPackage const& work = works[minerSource(index)].first;
+				steady_clock::time_point workSetAt = works[minerSource(index)].second;
+				uint64_t hashes = m->totalHashCount();
+				if (isNew || hashes != h.hashes || !work || m_pausedMiners.count(index))
+				{
+					// Forget past restarts once the miner has been healthy for a while.
+					if (h.restarts && now - h.lastStall > m_stallTimeout * c_healthyFactor)
+						h.restarts = 0;
+					h.hashes = hashes;
+					h.lastProgress = now;
+					continue;
+				}
+				if (now < h.holdOff)
+					continue;
+
+				std::string reason;
+				if (m->acknowledgedGeneration() != work.generation)
+				{
+					// A new epoch means DAG generation, which legitimately takes a while.
+					auto grace = work.seed == h.seed ? m_stallTimeout : m_stallTimeout * c_dagGraceFactor;
+					if (now - std::max(workSetAt, h.lastProgress) > grace)
+						reason = "job switch not acknowledged";
+				}
+				else
+				{
+					h.seed = work.seed;
+					if (now - h.lastProgress > m_stallTimeout)
+						reason = "no hashing progress";
+				}
+				if (reason.empty())
+					continue;
+
+				h.holdOff = now + m_stallTimeout * (1u << std::min(h.restarts, c_maxBackoffShift));
+				h.lastProgress = h.lastStall = now;
+				h.hashes = 0;	// The restarted miner counts from scratch.
+				h.restarts++;
+				stalled.emplace_back(index, reason);
+			}
+		}
+
+		for (auto const& s: stalled)
+		{
+			noteStall(s.first, s.second);
+			restartMiner(s.first);
+		}
+	}
+
+	/// Records a stall event and passes it to the onMinerStalled() handler.
+	/// @note Neither x_minerWork nor x_health may be held: the handler may call back into the farm.
+	void noteStall(unsigned _index, std::string const& _reason)
+	{
+		MinerStallEvent e;
+		MinerStalled handler;
+		{
+			Guard l(x_health);
+			e = MinerStallEvent{_index, _reason, m_health[_index].restarts, std::chrono::steady_clock::now()};
+			m_stallEvents.push_back(e);
+			if (m_stallEvents.size() > c_maxStallEvents)
+				m_stallEvents.pop_front();
+			handler = m_onMinerStalled;
+		}
+		cwarn << "Miner" << e.index << "stalled:" << e.reason << "; restart #" << e.restarts;
+		if (handler)
+			handler(e);
+	}
+
+	/// @note x_minerWork must be held.
+	std::vector<std::shared_ptr<Miner>>::iterator findMiner(unsigned _index)
+	{
+		return std::find_if(m_miners.begin(), m_miners.end(), [&](std::shared_ptr<Miner> const& _m) { return _m->minerIndex() == _index; });
+	}
+
+	/// The miners put their segment in the 4 bits below the pool's extranonce.
+	static const unsigned c_nonceSegments = 16;
+
+	/// @returns the lowest extranonce segment not used by any miner, running or
+	/// being restarted, or c_nonceSegments if all of them are taken.
+	/// @note x_minerWork must be held.
+	unsigned freeNonceSegment() const
+	{
+		unsigned segment = 0;
+		while (segment < c_nonceSegments && (
+			std::any_of(m_miners.begin(), m_miners.end(), [&](std::shared_ptr<Miner> const& _m) { return _m->nonceSegment() == segment; }) ||
+			std::any_of(m_restartingMiners.begin(), m_restartingMiners.end(), [&](std::pair<unsigned const, unsigned> const& _r) { return _r.second == segment; })))
+			++segment;
+		return segment;
+	}
+
 	mutable Mutex x_minerWork;
 	std::vector<std::shared_ptr<Miner>> m_miners;
-	WorkPackage m_work;
+	std::map<unsigned, std::string> m_minerSealers;	///< Sealer each miner was created with.
+	std::map<unsigned, unsigned> m_minerSources;	///< Work source each running miner is assigned to.
+	std::set<unsigned> m_pausedMiners;
+	std::map<unsigned, unsigned> m_restartingMiners;	///< Torn down by restartMiner(), not yet re-created, and their nonce segments.
+	std::atomic<uint64_t> m_workGeneration = {0};
+
+	/// Guards m_sources and m_onSolutionFound. Never held while calling into a miner.
+	mutable Mutex x_sources;
+	std::map<unsigned, WorkSource> m_sources;
 
 	std::atomic<bool> m_isMining = {false};
 
@@ -236,6 +892,23 @@ private:
 
 	mutable SolutionStats m_solutionStats;
 
+	Mutex x_solutions;
+	DuplicateSolutionFilter m_duplicates;
+
+	SwitchLatency m_switchLatency;
+
+	static const unsigned c_dagGraceFactor = 5;
+	static const unsigned c_maxBackoffShift = 5;
+	static const unsigned c_healthyFactor = 10;
+	static const size_t c_maxStallEvents = 64;
+	static const unsigned c_teardownSeconds = 30;	///< How long restartMiner() waits for a miner to stop.
+
+	mutable Mutex x_health;
+	std::chrono::seconds m_stallTimeout = std::chrono::seconds(0);
+	std::map<unsigned, MinerHealth> m_health;
+	std::deque<MinerStallEvent> m_stallEvents;
+	MinerStalled m_onMinerStalled;
+
 }; 
 
 }
@@ -1,5 +1,6 @@
 #include "Miner.h"
 #include "EthashAux.h"
+#include "Farm.h"
 
 using namespace dev;
 using namespace eth;
@@ -12,4 +13,9 @@ unsigned dev::eth::Miner::s_dagCreateDevice = 0;
 
 volatile void* dev::eth::Miner::s_dagInHostMemory = NULL;
 
+const unsigned dev::eth::Farm::c_dagGraceFactor;
+const unsigned dev::eth::Farm::c_maxBackoffShift;
+const unsigned dev::eth::Farm::c_healthyFactor;
+const unsigned dev::eth::Farm::c_teardownSeconds;
+
 
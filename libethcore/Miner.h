@@ -72,6 +72,7 @@ struct WorkingProgress
 	uint64_t rate() const { return ms == 0 ? 0 : hashes * 1000 / ms; }
 
 	std::vector<uint64_t> minersHashes;
+	std::vector<size_t> minersIndexes;	///< Device index of each entry in minersHashes.
 	uint64_t minerRate(const uint64_t hashCount) const { return ms == 0 ? 0 : hashCount * 1000 / ms; }
 };
 
@@ -85,7 +86,7 @@ inline std::ostream& operator<<(std::ostream& _out, WorkingProgress _p)
 	for (size_t i = 0; i < _p.minersHashes.size(); ++i)
 	{
 		mh = _p.minerRate(_p.minersHashes[i]) / 1000000.0f;
-		_out << "gpu/" << i << " " << EthTeal << std::fixed << std::setw(5) << std::setprecision(2) << mh << EthReset << "  ";
+		_out << "gpu/" << (i < _p.minersIndexes.size() ? _p.minersIndexes[i] : i) << " " << EthTeal << std::fixed << std::setw(5) << std::setprecision(2) << mh << EthReset << "  ";
 	}
 
 	return _out;
@@ -100,14 +101,16 @@ public:
 	void acceptedStale() { acceptedStales++; }
 	void rejectedStale() { rejectedStales++; }
 
+	void duplicate() { duplicates++; }
 
-	void reset() { accepts = rejects = failures = acceptedStales = rejectedStales = 0; }
+	void reset() { accepts = rejects = failures = acceptedStales = rejectedStales = duplicates = 0; }
 
 	unsigned getAccepts()			{ return accepts; }
 	unsigned getRejects()			{ return rejects; }
 	unsigned getFailures()			{ return failures; }
 	unsigned getAcceptedStales()	{ return acceptedStales; }
 	unsigned getRejectedStales()	{ return rejectedStales; }
+	unsigned getDuplicates()		{ return duplicates; }
 private:
 	unsigned accepts  = 0;
 	unsigned rejects  = 0;
@@ -115,11 +118,16 @@ private:
 
 	unsigned acceptedStales = 0;
 	unsigned rejectedStales = 0;
+
+	unsigned duplicates = 0;
 };
 
 inline std::ostream& operator<<(std::ostream& os, SolutionStats s)
 {
-	return os << "[A" << s.getAccepts() << "+" << s.getAcceptedStales() << ":R" << s.getRejects() << "+" << s.getRejectedStales() << ":F" << s.getFailures() << "]";
+	os << "[A" << s.getAccepts() << "+" << s.getAcceptedStales() << ":R" << s.getRejects() << "+" << s.getRejectedStales() << ":F" << s.getFailures();
+	if (s.getDuplicates())
+		os << ":D" << s.getDuplicates();
+	return os << "]";
 }
 
 class Miner;
@@ -141,6 +149,14 @@ public:
 	 * @return true iff the solution was good (implying that mining should be .
 	 */
 	virtual bool submitProof(Solution const& _p) = 0;
+
+	/**
+	 * @brief Called from a Miner once it launched the first search on a new work package.
+	 * @param _w The work package, including its trace timestamps.
+	 * @param _minerSet When the miner received the work package.
+	 * @param _launched When the first search was launched.
+	 */
+	virtual void noteSearchLaunched(WorkPackage const& _w, std::chrono::steady_clock::time_point _minerSet, std::chrono::steady_clock::time_point _launched) { (void)_w; (void)_minerSet; (void)_launched; }
 };
 
 /**
@@ -153,7 +169,8 @@ public:
 	Miner(std::string const& _name, FarmFace& _farm, size_t _index):
 		Worker(_name + std::to_string(_index)),
 		index(_index),
-		farm(_farm)
+		farm(_farm),
+		m_nonceSegment(_index)
 	{}
 
 	virtual ~Miner() = default;
@@ -162,18 +179,46 @@ public:
 	{
 		{
 			Guard l(x_work);
+			// A clean job voids whatever is still being searched for the source's earlier work.
+			if (_work.clean && _work.source == m_work.source)
+				m_voidBefore = _work.generation;
 			m_work = _work;
-			workSwitchStart = std::chrono::high_resolution_clock::now();
+			workSwitchStart = std::chrono::steady_clock::now();
 		}
 		pause();
 		kickOff();
 		m_hashCount = 0;
 	}
 
+	/**
+	 * @brief Changes the target of the current work package without restarting the search.
+	 * Miners pick it up with their next batch; solutions are checked against it before they are reported.
+	 */
+	void setBoundary(h256 const& _boundary)
+	{
+		Guard l(x_work);
+		m_work.boundary = _boundary;
+	}
+
 	uint64_t hashCount() const { return m_hashCount; }
 
 	void resetHashCount() { m_hashCount = 0; }
 
+	size_t minerIndex() const { return index; }
+
+	/// @returns the number of hashes computed since the miner was created. Never reset.
+	uint64_t totalHashCount() const { return m_totalHashCount; }
+
+	/// @returns the generation of the last work package the miner actually started searching.
+	uint64_t acknowledgedGeneration() const { return m_acknowledgedGeneration; }
+
+	/**
+	 * @brief Selects the slice of the extranonce space searched by this miner.
+	 * Takes effect with the next work package. Only 16 segments are available.
+	 */
+	void setNonceSegment(unsigned _segment) { m_nonceSegment = _segment; }
+	unsigned nonceSegment() const { return m_nonceSegment; }
+
 protected:
 
 	/**
@@ -189,7 +234,25 @@ protected:
 
 	WorkPackage work() const { Guard l(x_work); return m_work; }
 
-	void addHashCount(uint64_t _n) { m_hashCount += _n; }
+	void addHashCount(uint64_t _n) { m_hashCount += _n; m_totalHashCount += _n; }
+
+	/// @returns true if a clean job has replaced @a _work since it was handed out, so no more searches should be launched on it.
+	bool voided(WorkPackage const& _work) const { return _work.generation < m_voidBefore; }
+
+	/// To be called once the device is searching the given work package.
+	void acknowledgeWork(WorkPackage const& _work) { m_acknowledgedGeneration = _work.generation; }
+
+	/// To be called after the first search on a work package has been launched; reported once per package.
+	void noteSearchLaunched(WorkPackage const& _work)
+	{
+		if (_work.generation == m_launchedGeneration)
+			return;
+		m_launchedGeneration = _work.generation;
+		std::chrono::steady_clock::time_point minerSet;
+		DEV_GUARDED(x_work)
+			minerSet = workSwitchStart;
+		farm.noteSearchLaunched(_work, minerSet, std::chrono::steady_clock::now());
+	}
 
 	static unsigned s_dagLoadMode;
 	static volatile unsigned s_dagLoadIndex;
@@ -198,10 +261,15 @@ protected:
 
 	const size_t index = 0;
 	FarmFace& farm;
-	std::chrono::high_resolution_clock::time_point workSwitchStart;
+	std::chrono::steady_clock::time_point workSwitchStart;
 
 private:
 	uint64_t m_hashCount = 0;
+	std::atomic<uint64_t> m_totalHashCount = {0};
+	std::atomic<uint64_t> m_acknowledgedGeneration = {0};
+	std::atomic<uint64_t> m_voidBefore = {0};		///< Generation of the last clean work package.
+	uint64_t m_launchedGeneration = 0;
+	std::atomic<unsigned> m_nonceSegment;
 
 	WorkPackage m_work;
 	mutable Mutex x_work;
@@ -27,16 +27,22 @@ static void diffToTarget(uint32_t *target, double diff)
 }
 
 
-EthStratumClient::EthStratumClient(Farm* f, MinerType m, string const & host, string const & port, string const & user, string const & pass, int const & retries, int const & worktimeout, int const & protocol, string const & email)
-	: m_socket(m_io_service)
+EthStratumClient::EthStratumClient(Farm* f, MinerType m, string const & host, string const & port, string const & user, string const & pass, int const & retries, int const & worktimeout, int const & protocol, string const & email, bool standby, std::shared_ptr<StratumReactor> const& _reactor)
+	: m_pools(protocol, email), m_reactor(_reactor ? _reactor : std::make_shared<StratumReactor>()), m_io_service(m_reactor->service()),
+	m_socket(m_io_service), m_resolver(m_io_service), m_strand(m_io_service), m_reconnectTimer(m_io_service), m_heartbeatTimer(m_io_service)
 {
 	m_minerType = m;
-	m_primary.host = host;
-	m_primary.port = port;
-	m_primary.user = user;
-	m_primary.pass = pass;
-
-	p_active = &m_primary;
+	m_standby = standby;
+	m_keepalive = 15;
+	m_heartbeatInterval = 15;
+	m_heartbeatDeadline = 5;
+	cred_t primary;
+	primary.host = host;
+	primary.port = port;
+	primary.user = user;
+	primary.pass = pass;
+
+	p_active = &m_pools.at(m_pools.add(primary));
 
 	m_authorized = false;
 	m_connected = false;
@@ -51,13 +57,66 @@ EthStratumClient::EthStratumClient(Farm* f, MinerType m, string const & host, st
 	
 	p_farm = f;
 	p_worktimer = nullptr;
-	connect();
+	m_strand.post(boost::bind(&EthStratumClient::connect, this));
 }
 
 EthStratumClient::~EthStratumClient()
 {
-	m_io_service.stop();
-	m_serviceThread.join();
+	m_pools.stopProbing();
+	// Only this session is shut down; the reactor goes on serving the others
+	// and stops once its last owner lets go of it.
+	if (m_io_service.stopped())
+		return;
+	std::promise<void> closed;
+	m_strand.post([&]()
+	{
+		close();
+		drain(closed);
+	});
+	closed.get_future().wait();
+}
+
+void EthStratumClient::close()
+{
+	m_running = false;
+	m_connected = false;
+	m_authorized = false;
+	m_state = Disconnected;
+	m_onConnectionLost = nullptr;
+	m_onWork = nullptr;
+	boost::system::error_code ignored;
+	m_resolver.cancel();
+	m_reconnectTimer.cancel(ignored);
+	m_heartbeatTimer.cancel(ignored);
+	if (m_race)
+		m_race->cancel();
+	m_race.reset();
+	m_socket.close(ignored);
+	if (p_worktimer)
+	{
+		p_worktimer->cancel();
+		p_worktimer = nullptr;
+	}
+}
+
+void EthStratumClient::drain(std::promise<void>& o_closed)
+{
+	// The handlers of the operations close() cancelled are already queued on the
+	// service; going through it before the strand puts this behind them.
+	m_io_service.post([this, &o_closed]()
+	{
+		m_strand.post([this, &o_closed]()
+		{
+			if (!m_resolving)
+			{
+				o_closed.set_value();
+				return;
+			}
+			// A cancelled lookup only completes once the system resolver returns.
+			m_reconnectTimer.expires_from_now(boost::posix_time::milliseconds(10));
+			m_reconnectTimer.async_wait(m_strand.wrap([this, &o_closed](boost::system::error_code const&) { drain(o_closed); }));
+		});
+	});
 }
 
 void EthStratumClient::setFailover(string const & host, string const & port)
@@ -67,32 +126,121 @@ void EthStratumClient::setFailover(string const & host, string const & port)
 
 void EthStratumClient::setFailover(string const & host, string const & port, string const & user, string const & pass)
 {
-	m_failover.host = host;
-	m_failover.port = port;
-	m_failover.user = user;
-	m_failover.pass = pass;
+	addPool(host, port, user, pass);
 }
 
-void EthStratumClient::connect()
+void EthStratumClient::addPool(string const & host, string const & port, string const & user, string const & pass)
 {
-	tcp::resolver r(m_io_service);
-	tcp::resolver::query q(p_active->host, p_active->port);
-	
-	r.async_resolve(q, boost::bind(&EthStratumClient::resolve_handler,
-					this, boost::asio::placeholders::error,
-					boost::asio::placeholders::iterator));
+	cred_t pool;
+	pool.host = host;
+	pool.port = port;
+	pool.user = user;
+	pool.pass = pass;
+	m_pools.add(pool);
+}
 
-	cnote << "Connecting to stratum server " << p_active->host + ":" + p_active->port;
+void EthStratumClient::startProbing(unsigned _seconds)
+{
+	// Switching happens on the client's own thread, like any other reconnect.
+	m_pools.startProbing(_seconds, [this](size_t _pool)
+	{
+		m_strand.post(boost::bind(&EthStratumClient::switchPool, this, _pool));
+	});
+}
+
+void EthStratumClient::onWork(std::function<void(WorkPackage const&, string const&)> const& _handler)
+{
+	// Jobs arrive on the session's strand, so the handler is swapped there.
+	m_strand.post([=]()
+	{
+		m_onWork = _handler;
+		if (m_onWork && m_current)
+			m_onWork(m_current, m_jobs.current()->id);
+	});
+}
 
-	if (m_serviceThread.joinable())
+void EthStratumClient::reportHashrate(uint64_t _rate)
+{
+	if (m_shareRate > 0)
+		m_strand.post(boost::bind(&EthStratumClient::suggestDifficulty, this, _rate));
+}
+
+void EthStratumClient::suggestDifficulty(uint64_t _rate)
+{
+	if (m_protocol == STRATUM_PROTOCOL_ETHPROXY || !_rate)
+		return;
+	m_hashrate = m_hashrate > 0 ? m_hashrate + (_rate - m_hashrate) * c_hashrateSmoothing : _rate;
+	if (m_state != Mining || m_suggestRefused)
+		return;
+	if (m_suggestedAt > 0 && std::abs(m_hashrate - m_suggestedAt) < m_suggestedAt * c_resuggestChange)
+		return;
+	m_suggestedAt = m_hashrate;
+
+	// Difficulty 1 takes 2^32 hashes per share.
+	double difficulty = m_hashrate * 60 / (4294967296.0 * m_shareRate);
+	if (difficulty < 0.0001)
+		difficulty = 0.0001;
+	std::ostringstream os;
+	os << "{\"id\": " << m_requests.add(StratumRequest::SuggestDifficulty);
+	if (m_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+		os << ", \"method\": \"mining.suggest_difficulty\", \"params\": [" << std::setprecision(6) << difficulty << "]}\n";
+	else
 	{
-		// If the service thread have been created try to reset the service.
-		m_io_service.reset();
+		h256 target;
+		diffToTarget((uint32_t*)target.data(), difficulty);
+		os << ", \"method\": \"mining.suggest_target\", \"params\": [\"0x" << target.hex() << "\"]}\n";
 	}
+	cnote << "Suggesting share difficulty" << difficulty << "for" << m_hashrate / 1000000 << "Mh/s";
+	send(StratumOutbound::Control, os.str());
+}
+
+void EthStratumClient::setKeepalive(unsigned _idleSeconds)
+{
+	m_keepalive = _idleSeconds;
+	// The connection may already be up.
+	m_strand.post([this]()
+	{
+		if (m_connected)
+			configureKeepalive(m_socket, m_keepalive);
+	});
+}
+
+void EthStratumClient::setHeartbeat(unsigned _intervalSeconds, unsigned _deadlineSeconds)
+{
+	m_heartbeatInterval = _intervalSeconds;
+	m_heartbeatDeadline = _deadlineSeconds;
+	m_strand.post([this]()
+	{
+		if (m_connected && !m_heartbeatPending)
+			armHeartbeat(std::chrono::steady_clock::duration::zero());
+	});
+}
+
+void EthStratumClient::switchPool(size_t _pool)
+{
+	if (_pool == m_activePool || !m_connected)
+		return;
+	cnote << "Switching to stratum server" << m_pools.at(_pool).host + ":" + m_pools.at(_pool).port;
+	m_switchTo = _pool;
+	reconnect();
+}
+
+void EthStratumClient::connect()
+{
+	dev::setThreadName("stratum");
+	cnote << "Connecting to stratum server " << p_active->host + ":" + p_active->port;
+
+	std::vector<tcp::endpoint> endpoints;
+	if (ResolverCache::get().lookup(p_active->host, p_active->port, endpoints))
+		startConnect(endpoints);
 	else
 	{
-		// Otherwise, if the first time here, create new thread.
-		m_serviceThread = std::thread{boost::bind(&boost::asio::io_service::run, &m_io_service)};
+		m_state = Resolving;
+		m_resolving = true;
+		tcp::resolver::query q(p_active->host, p_active->port);
+		m_resolver.async_resolve(q, m_strand.wrap(boost::bind(&EthStratumClient::resolve_handler,
+						this, boost::asio::placeholders::error,
+						boost::asio::placeholders::iterator)));
 	}
 }
 
@@ -100,42 +248,87 @@ void EthStratumClient::connect()
 
 void EthStratumClient::reconnect()
 {
+	// Called from the handlers, so a second failure of the same connection
+	// (a read and a write failing, say) finds the reconnect already scheduled.
+	if (m_state == BackingOff || !m_running)
+	{
+		// A switch the prober asked for must not be applied by a later, unrelated reconnect.
+		m_switchTo = c_noSwitch;
+		return;
+	}
+
+	if (m_onConnectionLost)
+		m_onConnectionLost();
+
 	if (p_worktimer) {
 		p_worktimer->cancel();
 		p_worktimer = nullptr;
 	}
 
-	m_io_service.reset();
-	//m_socket.close(); // leads to crashes on Linux
+	// Whatever step the connection was in is abandoned; the handlers of the
+	// cancelled operations see m_connected false and do nothing.
+	boost::system::error_code ignored;
+	m_resolver.cancel();
+	m_heartbeatTimer.cancel(ignored);
+	if (m_race)
+		m_race->cancel();
+	m_race.reset();
+	m_socket.close(ignored);
 	m_authorized = false;
 	m_connected = false;
-		
-	if (!m_failover.host.empty())
+
+	// The next session (or pool) numbers its jobs afresh: nothing it sends may
+	// be compared with, or kept in favour of, the current job.
+	x_current.lock();
+	m_current.reset();
+	x_current.unlock();
+
+	bool switching = m_switchTo != c_noSwitch;
+
+	size_t next = m_activePool;
+	if (m_switchTo != c_noSwitch)
 	{
-		m_retries++;
+		next = m_switchTo;
+		m_switchTo = c_noSwitch;
+	}
+	else if (m_pools.size() > 1 && ++m_retries > m_maxRetries)
+		next = m_pools.next(m_activePool);
 
-		if (m_retries > m_maxRetries)
-		{
-			if (m_failover.host == "exit") {
-				disconnect();
-				return;
-			}
-			else if (p_active == &m_primary)
-			{
-				p_active = &m_failover;
-			}
-			else {
-				p_active = &m_primary;
-			}
-			m_retries = 0;
+	if (next != m_activePool)
+	{
+		if (m_pools.at(next).host == "exit") {
+			disconnect();
+			return;
 		}
+		m_activePool = next;
+		p_active = &m_pools.at(next);
+		m_pools.setActive(next);
+		m_retries = 0;
+
+		// Jobs and held shares belong to the pool that sent them; none may reach
+		// the next one under their job ids and worker.
+		x_current.lock();
+		m_jobs.clear();
+		m_heldShares.clear();
+		x_current.unlock();
 	}
-	
-	cnote << "Reconnecting in 3 seconds...";
-	boost::asio::deadline_timer timer(m_io_service, boost::posix_time::seconds(3));
-	timer.wait();
 
-	connect();
+	// A deliberate switch goes ahead at once; anything else backs off.
+	unsigned delay = switching ? 0 : m_backoff.next();
+	if (delay)
+		cnote << "Reconnecting in" << delay << "ms...";
+	m_state = BackingOff;
+	m_reconnectTimer.expires_from_now(boost::posix_time::milliseconds(delay));
+	m_reconnectTimer.async_wait(m_strand.wrap(boost::bind(&EthStratumClient::reconnect_handler, this, boost::asio::placeholders::error)));
+}
+
+void EthStratumClient::reconnect_handler(const boost::system::error_code& ec)
+{
+	if (!ec && m_running)
+	{
+		m_state = Disconnected;
+		connect();
+	}
 }
 
 void EthStratumClient::disconnect()
@@ -143,58 +336,124 @@ void EthStratumClient::disconnect()
 	cnote << "Disconnecting";
 	m_connected = false;
 	m_running = false;
-	if (p_farm->isMining())
+	m_state = Disconnected;
+	if (!m_standby && p_farm->isMining())
 	{
 		cnote << "Stopping farm";
 		p_farm->stop();
 	}
-	m_socket.close();
-	m_io_service.stop();
+	boost::system::error_code ignored;
+	m_reconnectTimer.cancel(ignored);
+	m_heartbeatTimer.cancel(ignored);
+	m_socket.close(ignored);
+	if (p_worktimer)
+	{
+		p_worktimer->cancel();
+		p_worktimer = nullptr;
+	}
 }
 
 void EthStratumClient::resolve_handler(const boost::system::error_code& ec, tcp::resolver::iterator i)
 {
+	m_resolving = false;
+	// A lookup that finished just before close() must not start a connection.
+	if (ec == boost::asio::error::operation_aborted || !m_running)
+		return;
+	std::vector<tcp::endpoint> endpoints;
 	if (!ec)
 	{
-		async_connect(m_socket, i, boost::bind(&EthStratumClient::connect_handler,
-						this, boost::asio::placeholders::error,
-						boost::asio::placeholders::iterator));
+		startConnect(ResolverCache::get().store(p_active->host, p_active->port, i));
+	}
+	else if (ResolverCache::get().lookup(p_active->host, p_active->port, endpoints, true))
+	{
+		cwarn << "Could not resolve host " << p_active->host + ":" + p_active->port + ", " << ec.message() << ", using the cached addresses";
+		startConnect(endpoints);
 	}
 	else
 	{
 		cerr << "Could not resolve host " << p_active->host + ":" + p_active->port + ", " << ec.message();
+		m_pools.recordFailure(m_activePool);
 		reconnect();
 	}
 }
 
-void EthStratumClient::connect_handler(const boost::system::error_code& ec, tcp::resolver::iterator i)
+void EthStratumClient::startConnect(std::vector<tcp::endpoint> const& _endpoints)
+{
+	m_state = Connecting;
+	auto race = std::make_shared<std::weak_ptr<ConnectRace>>();
+	m_race = ConnectRace::start(m_io_service, m_socket, _endpoints, m_strand.wrap([this, race](boost::system::error_code const& _ec, tcp::endpoint const& _endpoint, double _connectMs)
+	{
+		// A race that close() or reconnect() abandoned may still complete, even
+		// successfully; the client has moved on and must not be touched.
+		if (!m_running || m_state != Connecting || !m_race || race->lock() != m_race)
+			return;
+		m_race.reset();
+		connect_handler(_ec, _endpoint, _connectMs);
+	}));
+	// The completion runs on the strand, so it can't see this before it is set.
+	*race = m_race;
+}
+
+void EthStratumClient::startFarm()
+{
+	if (!p_farm->isMining())
+	{
+		cnote << "Starting farm";
+		if (m_minerType == MinerType::CL)
+			p_farm->start("opencl", false);
+		else if (m_minerType == MinerType::CUDA)
+			p_farm->start("cuda", false);
+		else if (m_minerType == MinerType::Mixed) {
+			p_farm->start("cuda", false);
+			p_farm->start("opencl", true);
+		}
+	}
+}
+
+void EthStratumClient::activate()
+{
+	m_standby = false;
+	x_current.lock();
+	WorkPackage current(m_current);
+	x_current.unlock();
+	cnote << "Mining on" << p_active->host;
+	startFarm();
+	if (current)
+		p_farm->setWork(m_workSource, current);
+}
+
+void EthStratumClient::connect_handler(const boost::system::error_code& ec, tcp::endpoint const& endpoint, double connectMs)
 {
 	dev::setThreadName("stratum");
 	
 	if (!ec)
 	{
 		m_connected = true;
-		cnote << "Connected to stratum server " << i->host_name() << ":" << p_active->port;
-		if (!p_farm->isMining())
-		{
-			cnote << "Starting farm";
-			if (m_minerType == MinerType::CL)
-				p_farm->start("opencl", false);
-			else if (m_minerType == MinerType::CUDA)
-				p_farm->start("cuda", false);
-			else if (m_minerType == MinerType::Mixed) {
-				p_farm->start("cuda", false);
-				p_farm->start("opencl", true);
-			}
-		}
-		std::ostream os(&m_requestBuffer);
+		m_state = Subscribing;
+		cnote << "Connected to stratum server " << p_active->host + " (" + endpoint.address().to_string() + "):" + p_active->port << "in" << std::setprecision(3) << connectMs << "ms";
+		m_loginSent = std::chrono::steady_clock::now();
+		m_pools.record(m_activePool, PoolHealth::Connect, connectMs);
+		configureKeepalive(m_socket, m_keepalive);
+		m_lastReceived = m_loginSent;
+		m_heartbeatPending = false;
+		armHeartbeat(std::chrono::seconds(m_heartbeatInterval));
+		m_awaitingJob = true;
+		m_suggestedAt = 0;
+		m_suggestRefused = false;
+		// Requests of the previous connection must not reach the new one.
+		m_outbound.clear(StratumOutbound::Control);
+		m_outbound.clear(StratumOutbound::Hashrate);
+		m_requests.clear();
+		if (!m_standby)
+			startFarm();
+		std::ostringstream os;
 
 		string user;
 		size_t p;
 
 		switch (m_protocol) {
 			case STRATUM_PROTOCOL_STRATUM:
-				os << "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": []}\n";
+				os << "{\"id\": " << m_requests.add(StratumRequest::Subscribe) << ", \"method\": \"mining.subscribe\", \"params\": []}\n";
 				break;
 			case STRATUM_PROTOCOL_ETHPROXY:
 				p = p_active->user.find_first_of(".");
@@ -206,41 +465,67 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec, tcp:
 
 				if (m_email.empty())
 				{
-					os << "{\"id\": 1, \"worker\":\"" << m_worker << "\", \"method\": \"eth_submitLogin\", \"params\": [\"" << user << "\"]}\n";
+					os << "{\"id\": " << m_requests.add(StratumRequest::Subscribe) << ", \"worker\":\"" << m_worker << "\", \"method\": \"eth_submitLogin\", \"params\": [\"" << user << "\"]}\n";
 				}
 				else
 				{
-					os << "{\"id\": 1, \"worker\":\"" << m_worker << "\", \"method\": \"eth_submitLogin\", \"params\": [\"" << user << "\", \"" << m_email << "\"]}\n";
+					os << "{\"id\": " << m_requests.add(StratumRequest::Subscribe) << ", \"worker\":\"" << m_worker << "\", \"method\": \"eth_submitLogin\", \"params\": [\"" << user << "\", \"" << m_email << "\"]}\n";
 				}
 				break;
 			case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
-				os << "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": [\"ethminer/" << ETH_PROJECT_VERSION << "\",\"EthereumStratum/1.0.0\"]}\n";
+				os << "{\"id\": " << m_requests.add(StratumRequest::Subscribe) << ", \"method\": \"mining.subscribe\", \"params\": [\"ethminer/" << ETH_PROJECT_VERSION << "\",\"EthereumStratum/1.0.0\"";
+				// Pools that honour the previous subscription id keep the extranonce and the job.
+				if (!m_session.empty() && m_sessionPool == m_activePool)
+					os << ",\"" << m_session << "\"";
+				os << "]}\n";
 				break;
 		}
 		
-		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-									boost::asio::placeholders::error));
+		send(StratumOutbound::Control, os.str());
 	}
 	else
 	{
 		cwarn << "Could not connect to stratum server " << p_active->host << ":" << p_active->port << ", " << ec.message();
+		ResolverCache::get().forget(p_active->host, p_active->port);
+		m_pools.recordFailure(m_activePool);
 		reconnect();
 	}
 
 }
 
 void EthStratumClient::readline() {
-	x_pending.lock();
 	if (m_pending == 0) {
-		async_read_until(m_socket, m_responseBuffer, "\n",
+		async_read_until(m_socket, m_responseBuffer, "\n", m_strand.wrap(
 			boost::bind(&EthStratumClient::readResponse, this,
-			boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
-	
+			boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
 		m_pending++;
-		
 	}
-	x_pending.unlock();
+}
+
+void EthStratumClient::send(StratumOutbound::Priority _priority, string&& _message)
+{
+	m_outbound.push(_priority, move(_message));
+	m_strand.post(boost::bind(&EthStratumClient::flush, this));
+}
+
+void EthStratumClient::flush()
+{
+	// A closed session sends nothing more, so no write outlives it.
+	if (!m_running)
+		return;
+	if (!m_outbound.beginBatch(m_writeBuffers))
+		return;
+	async_write(m_socket, m_writeBuffers, m_strand.wrap(
+		boost::bind(&EthStratumClient::handleWrite, this,
+		boost::asio::placeholders::error)));
+}
+
+void EthStratumClient::handleWrite(const boost::system::error_code& ec)
+{
+	m_outbound.endBatch();
+	handleResponse(ec);
+	// Whatever was queued while this batch was written goes out next.
+	flush();
 }
 
 void EthStratumClient::handleResponse(const boost::system::error_code& ec) {
@@ -258,12 +543,30 @@ void EthStratumClient::handleResponse(const boost::system::error_code& ec) {
 void EthStratumClient::readResponse(const boost::system::error_code& ec, std::size_t bytes_transferred)
 {
 	dev::setThreadName("stratum");
-	x_pending.lock();
 	m_pending = m_pending > 0 ? m_pending - 1 : 0;
-	x_pending.unlock();
 
 	if (!ec && bytes_transferred)
 	{
+		m_trace = WorkTrace();
+		m_trace.received = std::chrono::steady_clock::now();
+		m_lastReceived = m_trace.received;
+		m_heartbeatPending = false;
+
+		// Common messages are decoded in place; the rest goes through jsoncpp.
+		char const* line = boost::asio::buffer_cast<char const*>(m_responseBuffer.data());
+		StratumMessage msg;
+		if (StratumParser::parse(line, line + bytes_transferred, m_protocol, msg))
+		{
+			m_trace.parsed = std::chrono::steady_clock::now();
+			if (processMessage(msg))
+			{
+				m_responseBuffer.consume(bytes_transferred);
+				if (m_connected)
+					readline();
+				return;
+			}
+		}
+
 		std::istream is(&m_responseBuffer);
 		std::string response;
 		getline(is, response);
@@ -274,6 +577,7 @@ void EthStratumClient::readResponse(const boost::system::error_code& ec, std::si
 			Json::Reader reader;
 			if (reader.parse(response.c_str(), responseObject))
 			{
+				m_trace.parsed = std::chrono::steady_clock::now();
 				processReponse(responseObject);
 			}
 			else 
@@ -290,7 +594,9 @@ void EthStratumClient::readResponse(const boost::system::error_code& ec, std::si
 	}
 	else
 	{
-		cwarn << "Read response failed: " << ec.message();
+		// Aborted reads are the ones reconnect() cancelled.
+		if (ec != boost::asio::error::operation_aborted)
+			cwarn << "Read response failed: " << ec.message();
 		if (m_connected)
 			reconnect();
 	}
@@ -308,48 +614,62 @@ void EthStratumClient::processExtranonce(std::string& enonce)
 
 void EthStratumClient::processReponse(Json::Value& responseObject)
 {
+	std::ostringstream os;
+	Json::Value params;
+	int id = responseObject.get("id", Json::Value::null).asInt();
+	StratumRequest request;
+	completeRequest(id, request);
 	Json::Value error = responseObject.get("error", {});
-	if (error.isArray())
+	if (error.isArray() && request.kind != StratumRequest::Heartbeat)
 	{
 		string msg = error.get(1, "Unknown error").asString();
 		cnote << msg;
 	}
-	std::ostream os(&m_requestBuffer);
-	Json::Value params;
-	int id = responseObject.get("id", Json::Value::null).asInt();
-	switch (id)
+	switch (request.kind)
 	{
-		case 1:
+	case StratumRequest::Subscribe:
 		if (m_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
 		{
-			m_nextWorkDifficulty = 1;
+			// The result is [["mining.notify", <subscription id>, "EthereumStratum/1.0.0"], <extranonce>].
 			params = responseObject.get("result", Json::Value::null);
+			Json::Value id = params.isArray() ? params.get((Json::Value::ArrayIndex)0, Json::Value::null) : Json::Value::null;
+			id = id.isArray() ? id.get((Json::Value::ArrayIndex)1, Json::Value::null) : Json::Value::null;
+			string session = id.isString() ? id.asString() : "";
+			if (session.find_first_of("\"\\") != string::npos)
+				session.clear();
+			if (!session.empty() && session == m_session && m_sessionPool == m_activePool)
+				cnote << "Resumed stratum session" << session;
+			else
+				m_nextWorkDifficulty = 1;
+			m_session = session;
+			m_sessionPool = m_activePool;
 			if (params.isArray())
 			{
 				std::string enonce = params.get((Json::Value::ArrayIndex)1, "").asString();
 				processExtranonce(enonce);
 			}
 
-			os << "{\"id\": 2, \"method\": \"mining.extranonce.subscribe\", \"params\": []}\n";
+			os << "{\"id\": " << m_requests.add(StratumRequest::ExtranonceSubscribe) << ", \"method\": \"mining.extranonce.subscribe\", \"params\": []}\n";
 		}
 		if (m_protocol != STRATUM_PROTOCOL_ETHPROXY)
 		{
 			cnote << "Subscribed to stratum server";
-			os << "{\"id\": 3, \"method\": \"mining.authorize\", \"params\": [\"" << p_active->user << "\",\"" << p_active->pass << "\"]}\n";
+			m_state = Authorizing;
+			os << "{\"id\": " << m_requests.add(StratumRequest::Authorize) << ", \"method\": \"mining.authorize\", \"params\": [\"" << p_active->user << "\",\"" << p_active->pass << "\"]}\n";
 		}
 		else
 		{
 			m_authorized = true;
-			os << "{\"id\": 5, \"method\": \"eth_getWork\", \"params\": []}\n"; // not strictly required but it does speed up initialization
+			m_state = Mining;
+			m_backoff.reset();
+			os << "{\"id\": " << m_requests.add(StratumRequest::GetWork) << ", \"method\": \"eth_getWork\", \"params\": []}\n"; // not strictly required but it does speed up initialization
 		}
-		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-			boost::asio::placeholders::error));
+		send(StratumOutbound::Control, os.str());
 		break;
-	case 2:
+	case StratumRequest::ExtranonceSubscribe:
 		// nothing to do...
 		break;
-	case 3:
+	case StratumRequest::Authorize:
 		m_authorized = responseObject.get("result", Json::Value::null).asBool();
 		if (!m_authorized)
 		{
@@ -358,17 +678,25 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 			return;
 		}
 		cnote << "Authorized worker " << p_active->user;
+		m_state = Mining;
+		m_backoff.reset();
 		break;
-	case 4:
-		if (responseObject.get("result", false).asBool()) {
-			cnote << EthLime << "B-) Submitted and accepted." << EthReset;
-			p_farm->acceptedSolution(m_stale);
-		}
-		else {
-			cwarn << ":-( Not accepted.";
-			p_farm->rejectedSolution(m_stale);
+	case StratumRequest::Submit:
+		processSubmitResult(responseObject.get("result", false).asBool(), request);
+		break;
+	case StratumRequest::SuggestDifficulty:
+		// Not every pool knows the method; do not keep asking this session.
+		if (!error.isNull())
+		{
+			cnote << "The pool does not take share difficulty suggestions";
+			m_suggestRefused = true;
 		}
 		break;
+	case StratumRequest::Heartbeat:
+		// Only eth-proxy's heartbeat, eth_getWork, answers with anything of use.
+		if (m_protocol != STRATUM_PROTOCOL_ETHPROXY)
+			break;
+		// fall through
 	default:
 		string method, workattr;
 		unsigned index;
@@ -398,28 +726,7 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 					string sHeaderHash = params.get((Json::Value::ArrayIndex)2, "").asString();
 
 					if (sHeaderHash != "" && sSeedHash != "")
-					{
-						cnote << "Received new job #" + job;
-
-						h256 seedHash = h256(sSeedHash);
-
-						m_previous.header = m_current.header;
-						m_previous.seed = m_current.seed;
-						m_previous.boundary = m_current.boundary;
-						m_previous.startNonce = m_current.startNonce;
-						m_previous.exSizeBits = m_previous.exSizeBits;
-						m_previousJob = m_job;
-
-						m_current.header = h256(sHeaderHash);
-						m_current.seed = seedHash;
-						m_current.boundary = h256();
-						diffToTarget((uint32_t*)m_current.boundary.data(), m_nextWorkDifficulty);
-						m_current.startNonce = ethash_swap_u64(*((uint64_t*)m_extraNonce.data()));
-						m_current.exSizeBits = m_extraNonceHexSize * 4;
-						m_job = job;
-
-						p_farm->setWork(m_current);
-					}
+						processNotify(StratumSpan(job), h256(sHeaderHash), h256(sSeedHash), h256(), params.get((Json::Value::ArrayIndex)3, true) != Json::Value(false));
 				}
 				else
 				{
@@ -434,35 +741,7 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 
 
 					if (sHeaderHash != "" && sSeedHash != "" && sShareTarget != "")
-					{
-						cnote << "Received new job #" + job.substr(0, 8);
-
-						h256 seedHash = h256(sSeedHash);
-						h256 headerHash = h256(sHeaderHash);
-
-						if (headerHash != m_current.header)
-						{
-							//x_current.lock();
-							if (p_worktimer)
-								p_worktimer->cancel();
-
-							m_previous.header = m_current.header;
-							m_previous.seed = m_current.seed;
-							m_previous.boundary = m_current.boundary;
-							m_previousJob = m_job;
-
-							m_current.header = h256(sHeaderHash);
-							m_current.seed = seedHash;
-							m_current.boundary = h256(sShareTarget);
-							m_job = job;
-
-							p_farm->setWork(m_current);
-							//x_current.unlock();
-							p_worktimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(m_worktimeout));
-							p_worktimer->async_wait(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error));
-
-						}
-					}
+						processNotify(StratumSpan(job), h256(sHeaderHash), h256(sSeedHash), h256(sShareTarget), m_protocol == STRATUM_PROTOCOL_ETHPROXY || params.get((Json::Value::ArrayIndex)index, true) != Json::Value(false));
 				}
 			}
 		}
@@ -471,9 +750,7 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 			params = responseObject.get("params", Json::Value::null);
 			if (params.isArray())
 			{
-				m_nextWorkDifficulty = params.get((Json::Value::ArrayIndex)0, 1).asDouble();
-				if (m_nextWorkDifficulty <= 0.0001) m_nextWorkDifficulty = 0.0001;
-				cnote << "Difficulty set to " << m_nextWorkDifficulty;
+				processDifficulty(params.get((Json::Value::ArrayIndex)0, 1).asDouble());
 			}
 		}
 		else if (method == "mining.set_extranonce" && m_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
@@ -488,104 +765,329 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 		else if (method == "client.get_version")
 		{
 			os << "{\"error\": null, \"id\" : " << id << ", \"result\" : \"" << ETH_PROJECT_VERSION << "\"}\n";
-			async_write(m_socket, m_requestBuffer,
-				boost::bind(&EthStratumClient::handleResponse, this,
-				boost::asio::placeholders::error));
+			send(StratumOutbound::Control, os.str());
 		}
 		break;
 	}
 
 }
 
+bool EthStratumClient::processMessage(StratumMessage const& _msg)
+{
+	StratumRequest request;
+	StratumRequest::Kind kind;
+	switch (_msg.kind)
+	{
+	case StratumMessage::Result:
+		// Only share results are common enough to bother; the rest goes through processReponse().
+		if (!m_requests.peek(_msg.id, kind))
+			break;
+		if (kind != StratumRequest::Submit)
+			return false;
+		completeRequest(_msg.id, request);
+		processSubmitResult(_msg.accepted, request);
+		break;
+	case StratumMessage::Notify:
+		// An eth-proxy heartbeat returns the current job, which is no news.
+		if (completeRequest(_msg.id, request) && request.kind == StratumRequest::Heartbeat && _msg.header == m_current.header)
+			break;
+		processNotify(_msg.job, _msg.header, _msg.seed, _msg.boundary, _msg.clean);
+		break;
+	case StratumMessage::SetDifficulty:
+		processDifficulty(_msg.difficulty);
+		break;
+	}
+	return true;
+}
+
+bool EthStratumClient::completeRequest(int _id, StratumRequest& o_request)
+{
+	if (!m_requests.take(_id, o_request))
+		return false;
+	auto now = std::chrono::steady_clock::now();
+	m_pools.latency(m_activePool).record(o_request, now);
+	m_pools.record(m_activePool, PoolHealth::RoundTrip, std::chrono::duration<double, std::milli>(now - o_request.sentAt).count());
+	return true;
+}
+
+void EthStratumClient::processSubmitResult(bool _accepted, StratumRequest const& _request)
+{
+	m_pools.recordShare(m_activePool, _accepted, _request.stale);
+	if (_accepted) {
+		cnote << EthLime << "B-) Submitted and accepted." << EthReset;
+		p_farm->acceptedSolution(_request.stale);
+	}
+	else {
+		cwarn << ":-( Not accepted.";
+		p_farm->rejectedSolution(_request.stale);
+	}
+}
+
+void EthStratumClient::processDifficulty(double _difficulty)
+{
+	m_nextWorkDifficulty = _difficulty;
+	if (m_nextWorkDifficulty <= 0.0001) m_nextWorkDifficulty = 0.0001;
+	cnote << "Difficulty set to " << m_nextWorkDifficulty;
+}
+
+void EthStratumClient::renderSubmit(StratumJob& _job)
+{
+	_job.submit.render(m_protocol, p_active->user, m_worker, _job.id, _job.work.header, m_extraNonceHexSize);
+}
+
+void EthStratumClient::processNotify(StratumSpan const& _job, h256 const& _header, h256 const& _seed, h256 const& _boundary, bool _clean)
+{
+	bool login = m_awaitingJob;
+	if (m_awaitingJob)
+	{
+		m_awaitingJob = false;
+		m_pools.record(m_activePool, PoolHealth::FirstJob, std::chrono::duration<double, std::milli>(m_trace.received - m_loginSent).count());
+	}
+
+	setJob(_job, _header, _seed, _boundary, _clean, login);
+
+	// The first job of a session tells which of the solutions held while
+	// disconnected are still worth sending.
+	if (login)
+		replayHeldShares();
+}
+
+void EthStratumClient::setJob(StratumSpan const& _job, h256 const& _header, h256 const& _seed, h256 const& _boundary, bool _clean, bool _login)
+{
+	h256 boundary = _boundary;
+	uint64_t startNonce = m_current.startNonce;
+	int exSizeBits = m_current.exSizeBits;
+	if (m_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+	{
+		cnote << "Received new job #" + _job.str();
+		diffToTarget((uint32_t*)boundary.data(), m_nextWorkDifficulty);
+		startNonce = ethash_swap_u64(*((uint64_t*)m_extraNonce.data()));
+		exSizeBits = m_extraNonceHexSize * 4;
+	}
+	else
+		cnote << "Received new job #" + string(_job.data, min<size_t>(_job.size, 8));
+
+	if (_header == m_current.header && startNonce == m_current.startNonce && exSizeBits == m_current.exSizeBits)
+	{
+		// Same work under a new job id or share target: the miners carry on,
+		// Farm::setWork() only passes a new target on.
+		StratumJob* job = m_jobs.current();
+		if (boundary == m_current.boundary && _job == job->id.c_str())
+			return;
+		x_current.lock();
+		m_current.boundary = boundary;
+		job->id.assign(_job.data, _job.size);
+		job->work.boundary = boundary;
+		renderSubmit(*job);
+		x_current.unlock();
+
+		if (!m_standby)
+			p_farm->setWork(m_workSource, m_current);
+		if (m_onWork)
+			m_onWork(m_current, job->id);
+		return;
+	}
+
+	if (!_clean && !_login && m_current && _seed == m_current.seed && startNonce == m_current.startNonce && exSizeBits == m_current.exSizeBits)
+	{
+		// Without clean_jobs the current job stays valid, so there is no need
+		// to interrupt the miners; they move on with the next clean job. Only
+		// within a session, though, and only while the extranonce is the same.
+		cnote << "Job is not clean, keeping job #" + m_jobs.current()->id.substr(0, 8);
+		if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+			armWorkTimer();
+		return;
+	}
+
+	x_current.lock();
+	m_current.header = _header;
+	m_current.seed = _seed;
+	m_current.boundary = boundary;
+	m_current.startNonce = startNonce;
+	m_current.exSizeBits = exSizeBits;
+	m_current.clean = _clean;
+	m_current.trace = m_trace;
+	StratumJob& job = m_jobs.push(_job.str(), m_current, _clean);
+	renderSubmit(job);
+	x_current.unlock();
+
+	if (!m_standby)
+		p_farm->setWork(m_workSource, m_current);
+	if (m_onWork)
+		m_onWork(m_current, job.id);
+	if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+		armWorkTimer();
+}
+
+void EthStratumClient::armWorkTimer()
+{
+	if (p_worktimer)
+		p_worktimer->cancel();
+	p_worktimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(m_worktimeout));
+	p_worktimer->async_wait(m_strand.wrap(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error)));
+}
+
+void EthStratumClient::heartbeat_handler(const boost::system::error_code& ec)
+{
+	if (ec || !m_connected || !m_heartbeatInterval)
+		return;
+
+	std::chrono::microseconds rtt;
+	if (tcpRoundTrip(m_socket, rtt))
+		m_pools.latency(m_activePool).tcp.record(rtt);
+
+	auto idle = std::chrono::steady_clock::now() - m_lastReceived;
+	std::chrono::seconds interval(m_heartbeatInterval);
+	std::chrono::seconds deadline(m_heartbeatDeadline);
+	// Logging in takes several round trips, so it gets the deadline on top.
+	auto limit = m_state == Mining ? interval : interval + deadline;
+	if (m_heartbeatPending || (m_state != Mining && idle >= limit))
+	{
+		cwarn << "No response from stratum server in" << std::chrono::duration_cast<std::chrono::seconds>(idle).count() << "seconds.";
+		m_pools.recordFailure(m_activePool);
+		reconnect();
+		return;
+	}
+
+	auto wait = limit - idle;
+	if (m_state == Mining && wait <= std::chrono::steady_clock::duration::zero())
+	{
+		std::ostringstream os;
+		unsigned id = m_requests.add(StratumRequest::Heartbeat);
+		if (m_protocol == STRATUM_PROTOCOL_ETHPROXY)
+			os << "{\"id\": " << id << ", \"method\": \"eth_getWork\", \"params\": []}\n";
+		else if (m_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+			os << "{\"id\": " << id << ", \"method\": \"mining.extranonce.subscribe\", \"params\": []}\n";
+		else
+			os << "{\"id\": " << id << ", \"method\": \"mining.ping\", \"params\": []}\n";
+		send(StratumOutbound::Control, os.str());
+		m_heartbeatPending = true;
+		wait = deadline;
+	}
+	armHeartbeat(wait);
+}
+
+void EthStratumClient::armHeartbeat(std::chrono::steady_clock::duration _wait)
+{
+	if (!m_heartbeatInterval)
+		return;
+	m_heartbeatTimer.expires_from_now(boost::posix_time::microseconds(std::chrono::duration_cast<std::chrono::microseconds>(_wait).count()));
+	m_heartbeatTimer.async_wait(m_strand.wrap(boost::bind(&EthStratumClient::heartbeat_handler, this, boost::asio::placeholders::error)));
+}
+
 void EthStratumClient::work_timeout_handler(const boost::system::error_code& ec) {
 	if (!ec) {
 		cnote << "No new work received in" << m_worktimeout << "seconds.";
+		m_pools.recordFailure(m_activePool);
 		reconnect();
 	}
 }
 
 bool EthStratumClient::submitHashrate(string const & rate) {
 	// There is no stratum method to submit the hashrate so we use the rpc variant.
-	string json = "{\"id\": 6, \"jsonrpc\":\"2.0\", \"method\": \"eth_submitHashrate\", \"params\": [\"" + rate + "\",\"0x" + this->m_submit_hashrate_id + "\"]}\n";
-	std::ostream os(&m_requestBuffer);
-	os << json;
-	write(m_socket, m_requestBuffer);
+	string json = "{\"id\": " + to_string(m_requests.untracked()) + ", \"jsonrpc\":\"2.0\", \"method\": \"eth_submitHashrate\", \"params\": [\"" + rate + "\",\"0x" + this->m_submit_hashrate_id + "\"]}\n";
+	send(StratumOutbound::Hashrate, move(json));
 	return true;
 }
 
 bool EthStratumClient::submit(Solution solution) {
 	x_current.lock();
-	WorkPackage tempWork(m_current);
-	string temp_job = m_job;
-	WorkPackage tempPreviousWork(m_previous);
-	string temp_previous_job = m_previousJob;
+	bool connected = isConnected();
+	bool held = !connected && m_jobs.find(solution.headerHash, solution.nonce);
+	if (held)
+	{
+		if (m_heldShares.size() == c_maxHeldShares)
+			m_heldShares.pop_front();
+		m_heldShares.push_back(HeldShare{solution, std::chrono::steady_clock::now()});
+	}
 	x_current.unlock();
 
-	cnote << "Solution found; Submitting to" << p_active->host << "...";
-
-	string minernonce;
-	string nonceHex = toHex(solution.nonce);
-	if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM)
-		cnote << "  Nonce:" << "0x" + nonceHex;
+	if (connected)
+		return submitShare(solution);
+	if (held)
+		cnote << "Not connected; holding the solution until the pool is back.";
 	else
-		minernonce = nonceHex.substr(m_extraNonceHexSize, 16 - m_extraNonceHexSize);
+		cwarn << "Can't submit solution: Not connected";
+	return false;
+}
 
+void EthStratumClient::replayHeldShares()
+{
+	x_current.lock();
+	std::deque<HeldShare> held;
+	held.swap(m_heldShares);
+	x_current.unlock();
 
-	if (EthashAux::eval(tempWork.seed, tempWork.header, solution.nonce).value < tempWork.boundary)
+	// Jobs only change on this thread, so they stay put between the check and the submit.
+	for (HeldShare const& h: held)
 	{
-		string json;
-
-		switch (m_protocol) {
-			case STRATUM_PROTOCOL_STRATUM:
-				json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" + p_active->user + "\",\"" + temp_job + "\",\"0x" + nonceHex + "\",\"0x" + tempWork.header.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-				break;
-			case STRATUM_PROTOCOL_ETHPROXY:
-				json = "{\"id\": 4, \"worker\":\"" + m_worker + "\", \"method\": \"eth_submitWork\", \"params\": [\"0x" + nonceHex + "\",\"0x" + tempWork.header.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-				break;
-			case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
-				json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" + p_active->user + "\",\"" + temp_job + "\",\"" + minernonce + "\"]}\n";
-				break;
+		x_current.lock();
+		// A new session may have brought a new extranonce, which the held nonce does not start with.
+		StratumJob const* job = m_jobs.find(h.solution.headerHash, h.solution.nonce);
+		bool current = job && !m_jobs.stale(*job);
+		bool otherExtranonce = !job && m_jobs.find(h.solution.headerHash);
+		x_current.unlock();
+
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - h.foundAt).count();
+		if (current)
+		{
+			cnote << "Sending a solution held for" << ms << "ms.";
+			submitShare(h.solution);
 		}
-
-		std::ostream os(&m_requestBuffer);
-		os << json;
-		m_stale = false;
-		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-			boost::asio::placeholders::error));
-		return true;
+		else if (otherExtranonce)
+			cwarn << "Solution held for" << ms << "ms was searched under the previous session's extranonce; dropped.";
+		else
+			cwarn << "Solution held for" << ms << "ms is for a replaced job; dropped.";
 	}
-	else if (EthashAux::eval(tempPreviousWork.seed, tempPreviousWork.header, solution.nonce).value < tempPreviousWork.boundary)
-	{
-		string json;
+}
 
-		switch (m_protocol) {
-		case STRATUM_PROTOCOL_STRATUM:
-			json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" + p_active->user + "\",\"" + temp_previous_job + "\",\"0x" + nonceHex + "\",\"0x" + tempPreviousWork.header.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-			break;
-		case STRATUM_PROTOCOL_ETHPROXY:
-			json = "{\"id\": 4, \"worker\":\"" + m_worker + "\", \"method\": \"eth_submitWork\", \"params\": [\"0x" + nonceHex + "\",\"0x" + tempPreviousWork.header.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-			break;
-		case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
-			json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" + p_active->user + "\",\"" + temp_previous_job + "\",\"" + minernonce + "\"]}\n";
-			break;
-		}
+bool EthStratumClient::submitShare(Solution const& solution)
+{
+	cnote << "Solution found; Submitting to" << p_active->host << "...";
+	if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+		cnote << "  Nonce:" << "0x" + toHex(solution.nonce);
+
+	// The miner has already evaluated the solution; match it against the recent
+	// jobs by header instead of hashing it again for each of them. The request
+	// itself was rendered when the job arrived.
+	bool sent = false;
+	bool stale = false;
+	string job;
+	string json = m_outbound.acquire();
+	x_current.lock();
+	StratumJob const* found = m_jobs.find(solution.headerHash, solution.nonce);
+	bool otherExtranonce = !found && m_jobs.find(solution.headerHash);
+	bool meetsTarget = found && solution.result.value < found->work.boundary;
+	if (meetsTarget && m_jobs.acceptable(*found))
+	{
+		stale = m_jobs.stale(*found);
+		found->submit.write(m_requests.add(StratumRequest::Submit, stale, solution.generation), solution.nonce, solution.mixHash, json);
+		sent = true;
+	}
+	if (found)
+		job = found->id.substr(0, 8);
+	x_current.unlock();
 
-		std::ostream os(&m_requestBuffer);
-		os << json;
-		m_stale = true;
-		cwarn << "Submitting stale solution.";
-		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-			boost::asio::placeholders::error));
+	if (sent)
+	{
+		if (stale)
+			cwarn << "Submitting stale solution for job #" + job + ".";
+		send(StratumOutbound::Share, move(json));
 		return true;
 	}
-	else {
-		m_stale = false;
+
+	if (otherExtranonce)
+		cwarn << "Solution searched under a replaced extranonce; dropped.";
+	else if (!found)
+		cwarn << "Solution for a job no longer known; dropped.";
+	else if (meetsTarget)
+		cwarn << "Solution for job #" + job + ", which the pool no longer accepts; dropped.";
+	else if (solution.result.value < solution.boundary)
+		cnote << "Solution does not meet the new target of job #" + job + "; dropped.";
+	else
+	{
 		cwarn << "FAILURE: GPU gave incorrect result!";
 		p_farm->failedSolution();
 	}
-
 	return false;
 }
-
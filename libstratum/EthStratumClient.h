@@ -1,3 +1,5 @@
+#include <deque>
+#include <future>
 #include <iostream>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
@@ -9,6 +11,14 @@
 #include <libethcore/EthashAux.h>
 #include <libethcore/Miner.h>
 #include "BuildInfo.h"
+#include "StratumParser.h"
+#include "SubmitTemplate.h"
+#include "StratumJobs.h"
+#include "StratumOutbound.h"
+#include "StratumRequests.h"
+#include "StratumPools.h"
+#include "StratumConnect.h"
+#include "StratumReactor.h"
 
 
 using namespace std;
@@ -21,66 +31,193 @@ using namespace dev::eth;
 class EthStratumClient
 {
 public:
-	EthStratumClient(Farm* f, MinerType m, string const & host, string const & port, string const & user, string const & pass, int const & retries, int const & worktimeout, int const & protocol, string const & email);
+	/**
+	 * Without @a _reactor the client runs on a thread of its own. Clients sharing
+	 * a reactor are confined to their own strands on its thread; destroying one
+	 * only closes its own connection and waits for its handlers to finish, so it
+	 * must not be destroyed from the reactor's thread.
+	 */
+	EthStratumClient(Farm* f, MinerType m, string const & host, string const & port, string const & user, string const & pass, int const & retries, int const & worktimeout, int const & protocol, string const & email, bool standby = false, std::shared_ptr<StratumReactor> const& _reactor = nullptr);
 	~EthStratumClient();
 
 	void setFailover(string const & host, string const & port);
 	void setFailover(string const & host, string const & port, string const & user, string const & pass);
 
+	/// Adds a pool after the primary and failover ones. Connection failures move on to the best ranked pool.
+	void addPool(string const & host, string const & port, string const & user, string const & pass);
+
+	/// Probes the other pools every @a _seconds and moves to one that ranks consistently better.
+	void startProbing(unsigned _seconds);
+	StratumPools const& pools() const { return m_pools; }
+
+	/// Selects the Farm work source this client's jobs are set on (default 0).
+	void setWorkSource(unsigned _source) { m_workSource = _source; }
+
+	/**
+	 * In standby the client stays connected, subscribed and authorized and keeps
+	 * the latest job, but does not touch the Farm; see activate().
+	 */
+	void setStandby(bool _standby) { m_standby = _standby; }
+	bool isStandby() const { return m_standby; }
+
+	/// TCP keepalive idle time in seconds, 0 to leave the system default.
+	void setKeepalive(unsigned _idleSeconds);
+
+	/**
+	 * After @a _intervalSeconds without a message from the pool a heartbeat
+	 * request is sent; if nothing arrives within @a _deadlineSeconds the
+	 * connection is given up. 0 disables it.
+	 */
+	void setHeartbeat(unsigned _intervalSeconds, unsigned _deadlineSeconds);
+
+	/**
+	 * Asks the pool for a share difficulty that yields about @a _sharesPerMinute
+	 * at the hashrate passed to reportHashrate(); 0 (the default) leaves it to the pool.
+	 * Uses mining.suggest_difficulty on EthereumStratum and mining.suggest_target on stratum.
+	 */
+	void setShareRate(double _sharesPerMinute) { m_shareRate = _sharesPerMinute; }
+
+	/// The miners' current hashrate in H/s; a new difficulty is suggested when its average moves enough.
+	void reportHashrate(uint64_t _rate);
+
+	/// Leaves standby and hands the cached job to the Farm in one setWork().
+	void activate();
+
+	/// Called from the client's thread whenever the connection is lost or cannot be established.
+	void onConnectionLost(std::function<void()> const& _handler) { m_onConnectionLost = _handler; }
+
+	/**
+	 * Called from the client's thread with every new job and its pool job id,
+	 * also in standby; straight away with the current job if there is one.
+	 */
+	void onWork(std::function<void(WorkPackage const&, string const&)> const& _handler);
+
 	bool isRunning() { return m_running; }
 	bool isConnected() { return m_connected && m_authorized; }
-	h256 currentHeaderHash() { return m_current.header; }
-	bool current() { return static_cast<bool>(m_current); }
+	h256 currentHeaderHash() { Guard l(x_current); return m_current.header; }
+	bool current() { Guard l(x_current); return static_cast<bool>(m_current); }
 	bool submitHashrate(string const & rate);
+
+	/**
+	 * Sends a solution to the pool. While the client is not connected, solutions
+	 * for known jobs are held (the last c_maxHeldShares) and sent once the next
+	 * session's first job shows their job is still current.
+	 */
 	bool submit(Solution solution);
-	void reconnect();
+
 private:
 	void connect();
+	void reconnect();	///< Only on the service thread.
+	void close();		///< Cancels everything of this session for good; only on the service thread.
+	void drain(std::promise<void>& o_closed);	///< Fulfils @a o_closed once no handler of the closed session is left.
 	
 	void disconnect();
+	void startFarm();
+	void switchPool(size_t _pool);
 	void resolve_handler(const boost::system::error_code& ec, tcp::resolver::iterator i);
-	void connect_handler(const boost::system::error_code& ec, tcp::resolver::iterator i);
+	void startConnect(std::vector<tcp::endpoint> const& _endpoints);
+	void connect_handler(const boost::system::error_code& ec, tcp::endpoint const& endpoint, double connectMs);
 	void work_timeout_handler(const boost::system::error_code& ec);
+	void armWorkTimer();
+	void reconnect_handler(const boost::system::error_code& ec);
+	void heartbeat_handler(const boost::system::error_code& ec);
+	void armHeartbeat(std::chrono::steady_clock::duration _wait);
 
 	void readline();
+	void send(StratumOutbound::Priority _priority, string&& _message);
+	void flush();
+	void handleWrite(const boost::system::error_code& ec);
 	void handleResponse(const boost::system::error_code& ec);
 	void readResponse(const boost::system::error_code& ec, std::size_t bytes_transferred);
 	void processReponse(Json::Value& responseObject);
+	bool processMessage(StratumMessage const& _msg);
+	bool completeRequest(int _id, StratumRequest& o_request);
+	void processSubmitResult(bool _accepted, StratumRequest const& _request);
+	void processDifficulty(double _difficulty);
+	void suggestDifficulty(uint64_t _rate);
+	void processNotify(StratumSpan const& _job, h256 const& _header, h256 const& _seed, h256 const& _boundary, bool _clean);
+	/// @param _login The job is the first of its session.
+	void setJob(StratumSpan const& _job, h256 const& _header, h256 const& _seed, h256 const& _boundary, bool _clean, bool _login);
+	void renderSubmit(StratumJob& _job);	///< Caller holds x_current.
+	bool submitShare(Solution const& _solution);
+	void replayHeldShares();
 	
 	MinerType m_minerType;
 
-	cred_t * p_active;
-	cred_t m_primary;
-	cred_t m_failover;
+	StratumPools m_pools;
+	size_t m_activePool = 0;
+	size_t m_switchTo = c_noSwitch;		///< Set by switchPool() for reconnect().
+	cred_t const * p_active;
+
+	static const size_t c_noSwitch = size_t(-1);
 
 	string m_worker; // eth-proxy only;
 
-	bool m_authorized;
-	bool m_connected;
+	/// Where the connection is; only touched on the service thread.
+	enum State
+	{
+		Disconnected,
+		Resolving,
+		Connecting,
+		Subscribing,
+		Authorizing,
+		Mining,
+		BackingOff		///< Waiting for m_reconnectTimer.
+	};
+
+	std::atomic<bool> m_authorized;	///< Read by isConnected() from any thread.
+	std::atomic<bool> m_connected;
 	bool m_running = true;
+	State m_state = Disconnected;
+	bool m_resolving = false;	///< An async_resolve has not called back yet, even if cancelled.
+	std::atomic<bool> m_standby;
+	std::function<void()> m_onConnectionLost;
+	std::function<void(WorkPackage const&, string const&)> m_onWork;
+
+	std::chrono::steady_clock::time_point m_loginSent;
+	bool m_awaitingJob = false;			///< No job yet since the login.
+
+	std::atomic<unsigned> m_keepalive;
+	std::atomic<unsigned> m_heartbeatInterval;
+	std::atomic<unsigned> m_heartbeatDeadline;
+	std::chrono::steady_clock::time_point m_lastReceived;
+	bool m_heartbeatPending = false;	///< A heartbeat was sent and nothing has arrived since.
 
 	int	m_retries = 0;
 	int	m_maxRetries;
 	int m_worktimeout = 60;
 
-	std::mutex x_pending;
 	int m_pending;
 
 	Farm* p_farm;
+	unsigned m_workSource = 0;
 	std::mutex x_current;
 	WorkPackage m_current;
-	WorkPackage m_previous;
-
-	bool m_stale = false;
-
-	string m_job;
-	string m_previousJob;
-
-	std::thread m_serviceThread;  ///< The IO service thread.
-	boost::asio::io_service m_io_service;
+	WorkTrace m_trace;		///< Timestamps of the message being processed.
+	StratumJobs m_jobs;		///< The last jobs, m_current's first; guarded by x_current.
+
+	/// A solution found while the client was not connected.
+	struct HeldShare
+	{
+		Solution solution;
+		std::chrono::steady_clock::time_point foundAt;
+	};
+	static const unsigned c_maxHeldShares = 16;
+	std::deque<HeldShare> m_heldShares;	///< Oldest first; guarded by x_current.
+
+	std::shared_ptr<StratumReactor> m_reactor;
+	boost::asio::io_service& m_io_service;
 	tcp::socket m_socket;
-
-	boost::asio::streambuf m_requestBuffer;
+	tcp::resolver m_resolver;
+	io_service::strand m_strand;	///< Every handler of the session runs on it.
+	boost::asio::deadline_timer m_reconnectTimer;
+	boost::asio::deadline_timer m_heartbeatTimer;
+	std::shared_ptr<ConnectRace> m_race;	///< The connect in progress, if any.
+	ReconnectBackoff m_backoff;
+
+	StratumOutbound m_outbound;
+	StratumRequests m_requests;
+	std::vector<boost::asio::const_buffer> m_writeBuffers;	///< The batch being written, only touched on m_strand.
 	boost::asio::streambuf m_responseBuffer;
 
 	boost::asio::deadline_timer * p_worktimer;
@@ -90,8 +227,18 @@ private:
 
 	double m_nextWorkDifficulty;
 
+	/// Share difficulty suggestions; only touched on the service thread but m_shareRate.
+	static constexpr double c_hashrateSmoothing = 0.2;	///< Weight of a new sample in the average.
+	static constexpr double c_resuggestChange = 0.25;	///< Relative hashrate change that renews the suggestion.
+	std::atomic<double> m_shareRate = {0};
+	double m_hashrate = 0;				///< Moving average of the reported hashrate.
+	double m_suggestedAt = 0;			///< m_hashrate when the current suggestion was made; 0 for none this session.
+	bool m_suggestRefused = false;		///< The pool answered a suggestion with an error this session.
+
 	h64 m_extraNonce;
 	int m_extraNonceHexSize;
+	string m_session;			///< EthereumStratum subscription id, sent back on resubscribe.
+	size_t m_sessionPool = 0;	///< The pool m_session belongs to.
 	
 	string m_submit_hashrate_id;
 
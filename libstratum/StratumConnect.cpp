@@ -0,0 +1,295 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumConnect.cpp
+ */
+
+#include "StratumConnect.h"
+#include <algorithm>
+#include <memory>
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+
+namespace
+{
+
+/// Weight of a new connect time in the moving average.
+const double c_weight = 0.25;
+
+string key(string const& _host, string const& _port)
+{
+	return _host + ":" + _port;
+}
+
+/// One ConnectRace; kept alive by the handlers of its pending operations.
+struct Race: ConnectRace, enable_shared_from_this<Race>
+{
+	Race(boost::asio::io_service& _io, tcp::socket& _target): io(_io), target(_target), timer(_io) {}
+
+	void cancel() override
+	{
+		boost::system::error_code ignored;
+		done = true;
+		timer.cancel(ignored);
+		for (auto& s: sockets)
+			if (s)
+				s->close(ignored);
+	}
+
+	void startNext()
+	{
+		if (done || next == endpoints.size())
+			return;
+		size_t i = next++;
+		sockets[i].reset(new tcp::socket(io));
+		started[i] = chrono::steady_clock::now();
+		pending++;
+		auto self = shared_from_this();
+		sockets[i]->async_connect(endpoints[i], [self, i](boost::system::error_code const& _ec) { self->connected(i, _ec); });
+		if (next < endpoints.size())
+		{
+			timer.expires_from_now(boost::posix_time::milliseconds(ConnectRace::c_attemptDelay));
+			timer.async_wait([self](boost::system::error_code const& _ec)
+			{
+				if (!_ec)
+					self->startNext();
+			});
+		}
+	}
+
+	void connected(size_t _i, boost::system::error_code const& _ec)
+	{
+		pending--;
+		if (done)
+			return;
+		boost::system::error_code ignored;
+		if (_ec)
+		{
+			ResolverCache::get().recordFailure(endpoints[_i]);
+			sockets[_i]->close(ignored);
+			error = _ec;
+			// No point waiting out the delay when an attempt has already failed.
+			timer.cancel(ignored);
+			startNext();
+			if (!pending && next == endpoints.size())
+			{
+				done = true;
+				handler(error, tcp::endpoint(), 0);
+			}
+			return;
+		}
+
+		done = true;
+		timer.cancel(ignored);
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started[_i]).count();
+		ResolverCache::get().recordConnect(endpoints[_i], ms);
+		for (size_t j = 0; j < sockets.size(); ++j)
+			if (j != _i && sockets[j])
+				sockets[j]->close(ignored);
+		target = move(*sockets[_i]);
+		handler(_ec, endpoints[_i], ms);
+	}
+
+	boost::asio::io_service& io;
+	tcp::socket& target;
+	boost::asio::deadline_timer timer;
+	vector<tcp::endpoint> endpoints;
+	vector<unique_ptr<tcp::socket>> sockets;
+	vector<chrono::steady_clock::time_point> started;
+	ConnectRace::Handler handler;
+	size_t next = 0;
+	unsigned pending = 0;
+	bool done = false;
+	boost::system::error_code error;
+};
+
+}
+
+const unsigned ResolverCache::c_ttl;
+const unsigned ConnectRace::c_attemptDelay;
+const unsigned ReconnectBackoff::c_first;
+const unsigned ReconnectBackoff::c_max;
+
+ResolverCache& ResolverCache::get()
+{
+	static ResolverCache s_this;
+	return s_this;
+}
+
+bool ResolverCache::lookup(string const& _host, string const& _port, vector<Endpoint>& o_endpoints, bool _allowExpired) const
+{
+	Guard l(x_cache);
+	auto it = m_hosts.find(key(_host, _port));
+	if (it == m_hosts.end() || (!_allowExpired && it->second.expires < chrono::steady_clock::now()))
+		return false;
+	o_endpoints = ordered(it->second.endpoints);
+	return true;
+}
+
+vector<ResolverCache::Endpoint> ResolverCache::store(string const& _host, string const& _port, tcp::resolver::iterator _results)
+{
+	// Alternate the address families, starting with the resolver's first
+	// choice, so a broken IPv6 (or IPv4) path costs at most one attempt delay.
+	vector<Endpoint> first;
+	vector<Endpoint> second;
+	for (tcp::resolver::iterator end; _results != end; ++_results)
+	{
+		Endpoint e = *_results;
+		(first.empty() || first.front().protocol() == e.protocol() ? first : second).push_back(e);
+	}
+	Entry entry;
+	for (size_t i = 0; i < max(first.size(), second.size()); ++i)
+	{
+		if (i < first.size())
+			entry.endpoints.push_back(first[i]);
+		if (i < second.size())
+			entry.endpoints.push_back(second[i]);
+	}
+	entry.expires = chrono::steady_clock::now() + chrono::seconds(c_ttl);
+
+	Guard l(x_cache);
+	m_hosts[key(_host, _port)] = entry;
+	return ordered(entry.endpoints);
+}
+
+vector<ResolverCache::Endpoint> ResolverCache::resolve(boost::asio::io_service& _io, string const& _host, string const& _port, boost::system::error_code& o_ec)
+{
+	vector<Endpoint> endpoints;
+	o_ec = boost::system::error_code();
+	if (lookup(_host, _port, endpoints))
+		return endpoints;
+	tcp::resolver r(_io);
+	tcp::resolver::iterator results = r.resolve(tcp::resolver::query(_host, _port), o_ec);
+	if (!o_ec)
+		return store(_host, _port, results);
+	if (lookup(_host, _port, endpoints, true))
+		o_ec = boost::system::error_code();
+	return endpoints;
+}
+
+void ResolverCache::forget(string const& _host, string const& _port)
+{
+	Guard l(x_cache);
+	m_hosts.erase(key(_host, _port));
+}
+
+void ResolverCache::recordConnect(Endpoint const& _endpoint, double _ms)
+{
+	Guard l(x_cache);
+	double& avg = m_connectMs[_endpoint];
+	avg = avg > 0 ? avg + c_weight * (_ms - avg) : _ms;
+}
+
+void ResolverCache::recordFailure(Endpoint const& _endpoint)
+{
+	Guard l(x_cache);
+	m_connectMs[_endpoint] = -1;
+}
+
+double ResolverCache::connectMs(Endpoint const& _endpoint) const
+{
+	Guard l(x_cache);
+	auto it = m_connectMs.find(_endpoint);
+	return it != m_connectMs.end() && it->second > 0 ? it->second : 0;
+}
+
+vector<ResolverCache::Endpoint> ResolverCache::ordered(vector<Endpoint> const& _endpoints) const
+{
+	// Known good endpoints by connect time, then untried ones, then failed ones.
+	auto rank = [&](Endpoint const& _e)
+	{
+		auto it = m_connectMs.find(_e);
+		if (it == m_connectMs.end())
+			return 1e9;
+		return it->second < 0 ? 2e9 : it->second;
+	};
+	vector<Endpoint> ret = _endpoints;
+	stable_sort(ret.begin(), ret.end(), [&](Endpoint const& _a, Endpoint const& _b) { return rank(_a) < rank(_b); });
+	return ret;
+}
+
+shared_ptr<ConnectRace> ConnectRace::start(boost::asio::io_service& _io, tcp::socket& o_socket, vector<tcp::endpoint> const& _endpoints, Handler const& _handler)
+{
+	auto race = make_shared<Race>(_io, o_socket);
+	race->endpoints = _endpoints;
+	race->sockets.resize(_endpoints.size());
+	race->started.resize(_endpoints.size());
+	race->handler = _handler;
+	// Attempts are started from the io_service, like their completions.
+	_io.post([race]()
+	{
+		if (race->endpoints.empty() && !race->done)
+		{
+			race->done = true;
+			race->handler(boost::asio::error::host_not_found, tcp::endpoint(), 0);
+		}
+		race->startNext();
+	});
+	return race;
+}
+
+void dev::eth::configureKeepalive(tcp::socket& _socket, unsigned _idleSeconds)
+{
+	if (!_idleSeconds)
+		return;
+	boost::system::error_code ignored;
+	_socket.set_option(boost::asio::socket_base::keep_alive(true), ignored);
+#if defined(__linux__)
+	int fd = _socket.native_handle();
+	int idle = int(_idleSeconds);
+	int interval = max(1, idle / 3);
+	int count = 3;
+	unsigned userTimeout = _idleSeconds * 2000;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#if defined(TCP_USER_TIMEOUT)
+	setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof(userTimeout));
+#endif
+#endif
+}
+
+bool dev::eth::tcpRoundTrip(tcp::socket& _socket, chrono::microseconds& o_rtt)
+{
+#if defined(__linux__)
+	tcp_info info;
+	socklen_t size = sizeof(info);
+	if (getsockopt(_socket.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &size) || !info.tcpi_rtt)
+		return false;
+	o_rtt = chrono::microseconds(info.tcpi_rtt);
+	return true;
+#else
+	(void)_socket;
+	(void)o_rtt;
+	return false;
+#endif
+}
+
+unsigned ReconnectBackoff::next()
+{
+	unsigned ceiling = c_first << min(m_attempts, 6u);
+	ceiling = min(ceiling, c_max);
+	m_attempts++;
+	return uniform_int_distribution<unsigned>(ceiling / 2, ceiling)(m_random);
+}
@@ -0,0 +1,149 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumConnect.h
+ * Cached name resolution and concurrent ("happy eyeballs") connection set-up.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Resolved pool addresses, so a reconnect does not wait for DNS.
+ * The system resolver does not report record TTLs, so entries are kept for a
+ * fixed c_ttl, and an expired entry is still used when resolving fails.
+ * Endpoints come back ordered by how fast they connected last time, with ones
+ * that failed last.
+ * @threadsafe
+ */
+class ResolverCache
+{
+public:
+	typedef boost::asio::ip::tcp::endpoint Endpoint;
+
+	static ResolverCache& get();
+
+	/// @returns false if @a _host is not cached, or only expired when @a _allowExpired is false.
+	bool lookup(std::string const& _host, std::string const& _port, std::vector<Endpoint>& o_endpoints, bool _allowExpired = false) const;
+
+	/// Caches the results of a resolve; @returns them in connect order.
+	std::vector<Endpoint> store(std::string const& _host, std::string const& _port, boost::asio::ip::tcp::resolver::iterator _results);
+
+	/// Synchronous lookup with a resolve on cache miss.
+	std::vector<Endpoint> resolve(boost::asio::io_service& _io, std::string const& _host, std::string const& _port, boost::system::error_code& o_ec);
+
+	/// Drops a host whose addresses all failed, so the next lookup resolves it again.
+	void forget(std::string const& _host, std::string const& _port);
+
+	void recordConnect(Endpoint const& _endpoint, double _ms);
+	void recordFailure(Endpoint const& _endpoint);
+	/// @returns the moving average connect time of an endpoint, 0 if it never connected.
+	double connectMs(Endpoint const& _endpoint) const;
+
+private:
+	struct Entry
+	{
+		std::vector<Endpoint> endpoints;	///< IPv6 and IPv4 interleaved, in resolver order.
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	static const unsigned c_ttl = 300;
+
+	std::vector<Endpoint> ordered(std::vector<Endpoint> const& _endpoints) const;	///< Caller holds x_cache.
+
+	mutable Mutex x_cache;
+	std::map<std::string, Entry> m_hosts;
+	std::map<Endpoint, double> m_connectMs;	///< Negative after a failure.
+};
+
+/**
+ * @brief Connects to whichever of several endpoints answers first.
+ * Attempts start c_attemptDelay apart in the given order, or as soon as the
+ * previous one fails, and run concurrently; the first to connect wins and
+ * the others are closed. Connect times and failures go to the ResolverCache.
+ */
+class ConnectRace
+{
+public:
+	typedef std::function<void(boost::system::error_code const& _ec, boost::asio::ip::tcp::endpoint const& _endpoint, double _connectMs)> Handler;
+
+	virtual ~ConnectRace() {}
+
+	/**
+	 * @brief Starts the race. The winning connection is moved into @a o_socket,
+	 * which must outlive it, and @a _handler is called from @a _io.
+	 * @returns a handle for cancel().
+	 */
+	static std::shared_ptr<ConnectRace> start(boost::asio::io_service& _io, boost::asio::ip::tcp::socket& o_socket, std::vector<boost::asio::ip::tcp::endpoint> const& _endpoints, Handler const& _handler);
+
+	/// Closes the pending attempts; the handler is not called. Only call from @a _io's thread.
+	virtual void cancel() = 0;
+
+	/// RFC 8305's recommended connection attempt delay.
+	static const unsigned c_attemptDelay = 250;
+};
+
+/**
+ * @brief Turns on TCP keepalive with probes after @a _idleSeconds of silence,
+ * and, where the platform allows, a user timeout that drops the connection
+ * when sent data goes unacknowledged for twice that long.
+ * A connection to a pool that vanished without a FIN or RST then fails
+ * within seconds instead of waiting for the work timeout.
+ */
+void configureKeepalive(boost::asio::ip::tcp::socket& _socket, unsigned _idleSeconds);
+
+/// Reads the kernel's smoothed round-trip time of a connection; false where unsupported.
+bool tcpRoundTrip(boost::asio::ip::tcp::socket& _socket, std::chrono::microseconds& o_rtt);
+
+/**
+ * @brief Reconnect delays that double from c_first up to c_max. Each is drawn
+ * from the upper half of its range, so miners that lost the same pool do not
+ * all come back at the same moment.
+ */
+class ReconnectBackoff
+{
+public:
+	ReconnectBackoff(): m_random(std::random_device()()) {}
+
+	/// @returns the delay before the next attempt, in ms.
+	unsigned next();
+	/// Called once a session is established.
+	void reset() { m_attempts = 0; }
+
+private:
+	static const unsigned c_first = 1000;
+	static const unsigned c_max = 60000;
+
+	unsigned m_attempts = 0;
+	std::mt19937 m_random;
+};
+
+}
+}
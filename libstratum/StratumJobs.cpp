@@ -0,0 +1,71 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumJobs.cpp
+ */
+
+#include "StratumJobs.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+const unsigned StratumJobs::c_size;
+
+StratumJob& StratumJobs::push(string const& _id, WorkPackage const& _work, bool _clean)
+{
+	if (_clean || !m_count)
+		++m_block;
+	StratumJob& job = m_jobs[m_next];
+	m_next = (m_next + 1) % c_size;
+	if (m_count < c_size)
+		++m_count;
+	job.id = _id;
+	job.work = _work;
+	job.submit.clear();
+	job.block = m_block;
+	return job;
+}
+
+StratumJob const* StratumJobs::find(h256 const& _header) const
+{
+	for (unsigned i = 0; i < m_count; ++i)
+		if (m_jobs[slot(i)].work.header == _header)
+			return &m_jobs[slot(i)];
+	return nullptr;
+}
+
+StratumJob const* StratumJobs::find(h256 const& _header, uint64_t _nonce) const
+{
+	for (unsigned i = 0; i < m_count; ++i)
+	{
+		WorkPackage const& w = m_jobs[slot(i)].work;
+		if (w.header != _header)
+			continue;
+		// Without an extranonce the whole nonce is the miner's.
+		if (w.exSizeBits <= 0 || (_nonce >> (64 - w.exSizeBits)) == (w.startNonce >> (64 - w.exSizeBits)))
+			return &m_jobs[slot(i)];
+	}
+	return nullptr;
+}
+
+StratumJob const* StratumJobs::find(string const& _id) const
+{
+	for (unsigned i = 0; i < m_count; ++i)
+		if (m_jobs[slot(i)].id == _id)
+			return &m_jobs[slot(i)];
+	return nullptr;
+}
@@ -0,0 +1,97 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumJobs.h
+ * The recent jobs of a pool, to attribute late shares to.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <libethcore/EthashAux.h>
+#include "SubmitTemplate.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/// A job handed to the miners, with what it takes to submit a share for it.
+struct StratumJob
+{
+	std::string id;
+	WorkPackage work;		///< Header, seed, target, and the extranonce as start nonce and size.
+	SubmitTemplate submit;
+	unsigned block = 0;		///< Clean jobs up to and including this one.
+};
+
+/**
+ * @brief The last c_size jobs, newest first, so a share found on a job that has
+ * since been replaced still goes to the pool under that job's id and extranonce.
+ * Jobs are looked up by header or id with a scan of the ring, which for a
+ * handful of entries is cheaper than keeping hash indices up to date.
+ * @note Not thread-safe; the owner guards it.
+ */
+class StratumJobs
+{
+public:
+	static const unsigned c_size = 8;
+
+	/**
+	 * @brief Adds a job, replacing the oldest one once the ring is full.
+	 * @param _clean The pool voided the earlier jobs with this one.
+	 * @returns the new entry, for the caller to render its submit request.
+	 */
+	StratumJob& push(std::string const& _id, WorkPackage const& _work, bool _clean);
+
+	/// @returns the newest job, or nullptr if there is none.
+	StratumJob* current() { return m_count ? &m_jobs[slot(0)] : nullptr; }
+
+	/// @returns the newest job with the given header, or nullptr if none is left.
+	StratumJob const* find(h256 const& _header) const;
+	/**
+	 * @returns the newest job with the given header whose extranonce @a _nonce
+	 * starts with, or nullptr. A share searched under an extranonce the pool has
+	 * since replaced matches no job even if the header is unchanged.
+	 */
+	StratumJob const* find(h256 const& _header, uint64_t _nonce) const;
+	StratumJob const* find(std::string const& _id) const;
+
+	/// @returns true if a clean job has replaced @a _job; a share for it is stale.
+	bool stale(StratumJob const& _job) const { return _job.block != m_block; }
+
+	/**
+	 * @returns true if the pool is expected to take shares for @a _job: it is
+	 * either current or was replaced by the latest clean job, whose block the
+	 * pool still accepts stale shares for.
+	 */
+	bool acceptable(StratumJob const& _job) const { return _job.block + 1 >= m_block; }
+
+	void clear() { m_count = 0; }
+
+private:
+	/// The ring index of the job @a _age jobs older than the newest one.
+	unsigned slot(unsigned _age) const { return (m_next + c_size - 1 - _age) % c_size; }
+
+	std::array<StratumJob, c_size> m_jobs;
+	unsigned m_next = 0;	///< Where the next job goes.
+	unsigned m_count = 0;
+	unsigned m_block = 0;
+};
+
+}
+}
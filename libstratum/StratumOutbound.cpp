@@ -0,0 +1,87 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumOutbound.cpp
+ */
+
+#include "StratumOutbound.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+/// Recycled strings kept around; more than this is never in flight in practice.
+const size_t c_maxSpare = 16;
+}
+
+string StratumOutbound::acquire()
+{
+	Guard l(x_queue);
+	if (m_spare.empty())
+		return string();
+	string s = move(m_spare.back());
+	m_spare.pop_back();
+	s.clear();
+	return s;
+}
+
+void StratumOutbound::push(Priority _priority, string&& _message)
+{
+	Guard l(x_queue);
+	auto& queue = m_queued[_priority];
+	if (_priority == Hashrate && !queue.empty())
+		queue.back().swap(_message);
+	else
+		queue.push_back(move(_message));
+}
+
+bool StratumOutbound::beginBatch(vector<boost::asio::const_buffer>& o_buffers)
+{
+	Guard l(x_queue);
+	if (m_writing)
+		return false;
+	for (auto& queue: m_queued)
+	{
+		for (auto& m: queue)
+			m_batch.push_back(move(m));
+		queue.clear();
+	}
+	if (m_batch.empty())
+		return false;
+	o_buffers.clear();
+	for (auto const& m: m_batch)
+		o_buffers.push_back(boost::asio::buffer(m));
+	m_writing = true;
+	return true;
+}
+
+void StratumOutbound::endBatch()
+{
+	Guard l(x_queue);
+	for (auto& m: m_batch)
+		if (m_spare.size() < c_maxSpare)
+			m_spare.push_back(move(m));
+	m_batch.clear();
+	m_writing = false;
+}
+
+void StratumOutbound::clear(Priority _priority)
+{
+	Guard l(x_queue);
+	m_queued[_priority].clear();
+}
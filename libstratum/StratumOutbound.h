@@ -0,0 +1,83 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumOutbound.h
+ * Prioritised queue of outgoing stratum messages.
+ */
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Outgoing messages of one stratum connection.
+ * Only one batch is written at a time. A batch takes everything queued so far,
+ * shares first, then protocol control messages, then hashrate reports, so it
+ * can go out as a single gather-write. Only the latest queued hashrate report
+ * is kept. Message strings are recycled to avoid allocating per message.
+ * @threadsafe
+ */
+class StratumOutbound
+{
+public:
+	enum Priority
+	{
+		Share,
+		Control,
+		Hashrate,
+		PriorityCount
+	};
+
+	/// @returns an empty string, with capacity left over from an earlier message if possible.
+	std::string acquire();
+
+	/// Queues a message; a queued hashrate report is replaced by a newer one.
+	void push(Priority _priority, std::string&& _message);
+
+	/**
+	 * @brief Starts writing a batch.
+	 * @param o_buffers Filled with the queued messages in priority order.
+	 * @returns false if a batch is already being written or nothing is queued.
+	 * Every successful call must be followed by endBatch().
+	 */
+	bool beginBatch(std::vector<boost::asio::const_buffer>& o_buffers);
+
+	/// Releases the batch being written, whether it was sent or not.
+	void endBatch();
+
+	/// Drops all queued messages of the given priority.
+	void clear(Priority _priority);
+
+private:
+	Mutex x_queue;
+	std::array<std::deque<std::string>, PriorityCount> m_queued;
+	std::vector<std::string> m_batch;
+	std::vector<std::string> m_spare;
+	bool m_writing = false;
+};
+
+}
+}
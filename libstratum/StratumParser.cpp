@@ -0,0 +1,390 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumParser.cpp
+ */
+
+#include "StratumParser.h"
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <libethcore/Miner.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+bool StratumSpan::operator==(char const* _s) const
+{
+	return strlen(_s) == size && !memcmp(data, _s, size);
+}
+
+namespace
+{
+
+struct Token
+{
+	enum Type { String, Number, True, False, Null, Compound };
+	Type type = Null;
+	StratumSpan text;
+};
+
+/// Forward-only JSON scanner. Strings with escapes are not supported and make it fail.
+class Scanner
+{
+public:
+	Scanner(char const* _begin, char const* _end): m_p(_begin), m_end(_end) {}
+
+	char const* pos() { skipSpace(); return m_p; }
+	bool atEnd() { skipSpace(); return m_p == m_end; }
+
+	bool eat(char _c)
+	{
+		skipSpace();
+		if (m_p == m_end || *m_p != _c)
+			return false;
+		++m_p;
+		return true;
+	}
+
+	bool string(StratumSpan& o_s)
+	{
+		if (!eat('"'))
+			return false;
+		char const* b = m_p;
+		for (; m_p != m_end && *m_p != '"'; ++m_p)
+			if (*m_p == '\\')
+				return false;
+		if (m_p == m_end)
+			return false;
+		o_s.data = b;
+		o_s.size = m_p++ - b;
+		return true;
+	}
+
+	bool value(Token& o_t)
+	{
+		skipSpace();
+		if (m_p == m_end)
+			return false;
+		switch (*m_p)
+		{
+		case '"':
+			o_t.type = Token::String;
+			return string(o_t.text);
+		case 't':
+			o_t.type = Token::True;
+			return literal("true");
+		case 'f':
+			o_t.type = Token::False;
+			return literal("false");
+		case 'n':
+			o_t.type = Token::Null;
+			return literal("null");
+		case '[':
+		case '{':
+			o_t.type = Token::Compound;
+			return skipCompound();
+		default:
+			o_t.type = Token::Number;
+			o_t.text.data = m_p;
+			while (m_p != m_end && (isdigit(*m_p) || *m_p == '-' || *m_p == '+' || *m_p == '.' || *m_p == 'e' || *m_p == 'E'))
+				++m_p;
+			o_t.text.size = m_p - o_t.text.data;
+			return o_t.text.size > 0;
+		}
+	}
+
+private:
+	void skipSpace()
+	{
+		while (m_p != m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n'))
+			++m_p;
+	}
+
+	bool literal(char const* _lit)
+	{
+		size_t n = strlen(_lit);
+		if (size_t(m_end - m_p) < n || memcmp(m_p, _lit, n))
+			return false;
+		m_p += n;
+		return true;
+	}
+
+	/// Skips a nested array or object; escapes inside strings are allowed here.
+	bool skipCompound()
+	{
+		unsigned depth = 0;
+		bool inString = false;
+		for (; m_p != m_end; ++m_p)
+		{
+			char c = *m_p;
+			if (inString)
+			{
+				if (c == '\\' && m_p + 1 != m_end)
+					++m_p;
+				else if (c == '"')
+					inString = false;
+			}
+			else if (c == '"')
+				inString = true;
+			else if (c == '[' || c == '{')
+				++depth;
+			else if ((c == ']' || c == '}') && !--depth)
+			{
+				++m_p;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	char const* m_p;
+	char const* m_end;
+};
+
+/// Reads the first elements of the array at @a _at; the rest is skipped.
+bool elements(char const* _at, char const* _end, Token* o_tokens, unsigned _max, unsigned& o_count)
+{
+	Scanner s(_at, _end);
+	o_count = 0;
+	if (!s.eat('['))
+		return false;
+	if (s.eat(']'))
+		return true;
+	do
+	{
+		Token t;
+		if (!s.value(t))
+			return false;
+		if (o_count < _max)
+			o_tokens[o_count++] = t;
+	}
+	while (s.eat(','));
+	return s.eat(']');
+}
+
+bool toInt(StratumSpan const& _s, int& o_value)
+{
+	char const* p = _s.data;
+	char const* e = _s.data + _s.size;
+	bool negative = p != e && *p == '-';
+	if (negative)
+		++p;
+	if (p == e)
+		return false;
+	long long v = 0;
+	for (; p != e; ++p)
+	{
+		if (!isdigit(*p))
+			return false;
+		v = v * 10 + (*p - '0');
+		if (v > INT_MAX)
+			return false;
+	}
+	o_value = int(negative ? -v : v);
+	return true;
+}
+
+/// Locale independent decimal parser for the difficulty.
+bool toDouble(StratumSpan const& _s, double& o_value)
+{
+	char const* p = _s.data;
+	char const* e = _s.data + _s.size;
+	bool negative = p != e && *p == '-';
+	if (negative)
+		++p;
+	double v = 0;
+	int scale = 0;
+	bool digits = false;
+	for (; p != e && isdigit(*p); ++p, digits = true)
+		v = v * 10 + (*p - '0');
+	if (p != e && *p == '.')
+		for (++p; p != e && isdigit(*p); ++p, digits = true, --scale)
+			v = v * 10 + (*p - '0');
+	if (!digits)
+		return false;
+	if (p != e && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negExp = p != e && *p == '-';
+		if (p != e && (*p == '-' || *p == '+'))
+			++p;
+		if (p == e)
+			return false;
+		int x = 0;
+		for (; p != e && isdigit(*p); ++p)
+			x = min(x * 10 + (*p - '0'), 1000);
+		scale += negExp ? -x : x;
+	}
+	if (p != e)
+		return false;
+	double f = 10;
+	for (unsigned n = unsigned(abs(scale)); n; n >>= 1, f *= f)
+		if (n & 1)
+			v = scale < 0 ? v / f : v * f;
+	o_value = negative ? -v : v;
+	return true;
+}
+
+bool hasHexPrefix(StratumSpan const& _s)
+{
+	return _s.size >= 2 && _s.data[0] == '0' && (_s.data[1] == 'x' || _s.data[1] == 'X');
+}
+
+/// Header and seed hashes must have all 64 digits, like h256(std::string) requires.
+bool decodeFullHash(Token const& _t, h256& o_hash)
+{
+	if (_t.type != Token::String || _t.text.size - (hasHexPrefix(_t.text) ? 2 : 0) != 64)
+		return false;
+	return StratumParser::decodeHash(_t.text, o_hash);
+}
+
+}
+
+bool StratumParser::decodeHash(StratumSpan const& _hex, h256& o_hash)
+{
+	char const* b = _hex.data + (hasHexPrefix(_hex) ? 2 : 0);
+	char const* p = _hex.data + _hex.size;
+	if (p == b || p - b > 64)
+		return false;
+	o_hash = h256();
+	byte* out = o_hash.data() + h256::size;
+	for (unsigned k = 0; p != b; ++k)
+	{
+		char c = *--p;
+		int n = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+		if (n < 0)
+			return false;
+		if (k & 1)
+			*out |= byte(n << 4);
+		else
+			*--out = byte(n);
+	}
+	return true;
+}
+
+bool StratumParser::parse(char const* _begin, char const* _end, int _protocol, StratumMessage& o_msg)
+{
+	Scanner s(_begin, _end);
+	int id = 0;
+	StratumSpan method;
+	char const* params = nullptr;
+	Token result;
+	char const* resultAt = nullptr;
+
+	if (!s.eat('{') || s.eat('}'))
+		return false;
+	do
+	{
+		StratumSpan key;
+		Token t;
+		if (!s.string(key) || !s.eat(':'))
+			return false;
+		if (key == "params")
+			params = s.pos();
+		else if (key == "result")
+			resultAt = s.pos();
+		if (!s.value(t))
+			return false;
+		if (key == "id")
+		{
+			// jsoncpp's asInt() treats null as 0 and throws on anything but numbers.
+			if (t.type == Token::Number ? !toInt(t.text, id) : t.type != Token::Null)
+				return false;
+		}
+		else if (key == "method")
+		{
+			if (t.type != Token::String)
+				return false;
+			method = t.text;
+		}
+		else if (key == "result")
+			result = t;
+		else if (key == "error" && t.type != Token::Null)
+			return false;
+	}
+	while (s.eat(','));
+	if (!s.eat('}') || !s.atEnd())
+		return false;
+
+	o_msg = StratumMessage();
+	o_msg.id = id;
+	if (method.empty() && (result.type == Token::True || result.type == Token::False || result.type == Token::Null))
+	{
+		// A plain response; which request it answers is up to the caller.
+		o_msg.kind = StratumMessage::Result;
+		o_msg.accepted = result.type == Token::True;
+		return true;
+	}
+
+	Token tokens[5];
+	unsigned count = 0;
+	if (_protocol == STRATUM_PROTOCOL_ETHPROXY)
+	{
+		// eth-proxy sends work as the result of eth_getWork, or pushes it unasked.
+		if (!resultAt || result.type != Token::Compound || *resultAt != '[')
+			return false;
+		if (!elements(resultAt, _end, tokens, 3, count) || count < 3)
+			return false;
+		if (!decodeFullHash(tokens[0], o_msg.header) || !decodeFullHash(tokens[1], o_msg.seed))
+			return false;
+		o_msg.job = tokens[0].text;
+	}
+	else if (method == "mining.notify")
+	{
+		if (!params || !elements(params, _end, tokens, 5, count))
+			return false;
+		if (_protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+		{
+			if (count < 3 || tokens[0].type != Token::String || tokens[0].text.empty())
+				return false;
+			if (!decodeFullHash(tokens[1], o_msg.seed) || !decodeFullHash(tokens[2], o_msg.header))
+				return false;
+			o_msg.job = tokens[0].text;
+			o_msg.clean = count < 4 || tokens[3].type != Token::False;
+			o_msg.kind = StratumMessage::Notify;
+			return true;
+		}
+		if (count < 4 || tokens[0].type != Token::String)
+			return false;
+		if (!decodeFullHash(tokens[1], o_msg.header) || !decodeFullHash(tokens[2], o_msg.seed))
+			return false;
+		o_msg.job = tokens[0].text;
+		o_msg.clean = count < 5 || tokens[4].type != Token::False;
+		tokens[0] = tokens[3];
+	}
+	else if (method == "mining.set_difficulty" && _protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+	{
+		if (!params || !elements(params, _end, tokens, 1, count) || count < 1 || tokens[0].type != Token::Number)
+			return false;
+		if (!toDouble(tokens[0].text, o_msg.difficulty))
+			return false;
+		o_msg.kind = StratumMessage::SetDifficulty;
+		return true;
+	}
+	else
+		return false;
+
+	// The share target of the stratum and eth-proxy notifications; some pools
+	// strip its leading zeros.
+	Token const& target = _protocol == STRATUM_PROTOCOL_ETHPROXY ? tokens[2] : tokens[0];
+	if (target.type != Token::String || !hasHexPrefix(target.text) || !decodeHash(target.text, o_msg.boundary))
+		return false;
+	o_msg.kind = StratumMessage::Notify;
+	return true;
+}
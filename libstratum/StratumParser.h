@@ -0,0 +1,92 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumParser.h
+ * Allocation-free parser for the common stratum messages.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Characters inside the buffer that was parsed. Only valid as long as that buffer is.
+struct StratumSpan
+{
+	StratumSpan() = default;
+	StratumSpan(char const* _data, size_t _size): data(_data), size(_size) {}
+	explicit StratumSpan(std::string const& _s): data(_s.data()), size(_s.size()) {}
+
+	char const* data = nullptr;
+	size_t size = 0;
+
+	bool empty() const { return !size; }
+	std::string str() const { return std::string(data, size); }
+	bool operator==(char const* _s) const;
+};
+
+/// A stratum message decoded by StratumParser.
+struct StratumMessage
+{
+	enum Kind
+	{
+		Result,			///< Response with a boolean (or null) result and no error.
+		Notify,			///< New job, from mining.notify or eth-proxy work.
+		SetDifficulty	///< EthereumStratum mining.set_difficulty.
+	};
+
+	Kind kind = Result;
+	int id = 0;				///< 0 if the message has none (or null).
+	bool accepted = false;	///< Result: the result is true.
+	StratumSpan job;		///< Notify: job id (the header hash on eth-proxy).
+	h256 header;			///< Notify: header hash.
+	h256 seed;				///< Notify: seed hash.
+	h256 boundary;			///< Notify: share target (not sent by EthereumStratum).
+	bool clean = true;		///< Notify: clean_jobs, i.e. earlier jobs are void. Always set on eth-proxy.
+	double difficulty = 0;	///< SetDifficulty.
+};
+
+/**
+ * @brief Decodes the messages that make up nearly all stratum traffic (job
+ * notifications, difficulty changes and plain responses) straight from the
+ * receive buffer, without building a Json::Value.
+ * Anything else - errors, escaped strings, structured results, unknown
+ * methods - is rejected so the caller can fall back to jsoncpp.
+ */
+class StratumParser
+{
+public:
+	/**
+	 * @brief Parses one line.
+	 * @param _begin, _end The line, with or without its line terminator.
+	 * @param _protocol One of the STRATUM_PROTOCOL_* values.
+	 * @param o_msg Filled in on success; spans point into [_begin, _end).
+	 * @returns false if the line must be handled by the generic path.
+	 */
+	static bool parse(char const* _begin, char const* _end, int _protocol, StratumMessage& o_msg);
+
+	/// Decodes up to 64 hex digits, with optional 0x prefix, into a right-aligned hash.
+	static bool decodeHash(StratumSpan const& _hex, h256& o_hash);
+};
+
+}
+}
@@ -0,0 +1,375 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumPools.cpp
+ */
+
+#include "StratumPools.h"
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <boost/asio.hpp>
+#include <json/json.h>
+#include <libdevcore/Log.h>
+#include "BuildInfo.h"
+#include "StratumParser.h"
+#include "StratumConnect.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+
+namespace
+{
+
+/// Weight of a new measurement in the moving averages.
+const double c_weight = 0.25;
+/// Per-share decay of the share counts; about the last 50 shares count.
+const double c_decay = 0.98;
+/// Shares assumed good before any are counted, so a single reject does not disqualify a pool.
+const double c_prior = 10;
+const unsigned c_maxFailures = 3;
+
+/// The requests that get a pool to send its first job: login and, where needed, the work request.
+string loginRequest(int _protocol, cred_t const& _pool, string const& _email)
+{
+	ostringstream os;
+	switch (_protocol)
+	{
+	case STRATUM_PROTOCOL_ETHPROXY:
+	{
+		size_t p = _pool.user.find_first_of(".");
+		string worker = p + 1 <= _pool.user.length() ? _pool.user.substr(p + 1) : "";
+		os << "{\"id\": 1, \"worker\":\"" << worker << "\", \"method\": \"eth_submitLogin\", \"params\": [\"" << _pool.user.substr(0, p) << "\"";
+		if (!_email.empty())
+			os << ", \"" << _email << "\"";
+		os << "]}\n";
+		os << "{\"id\": 2, \"method\": \"eth_getWork\", \"params\": []}\n";
+		break;
+	}
+	case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
+		os << "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": [\"ethminer/" << ETH_PROJECT_VERSION << "\",\"EthereumStratum/1.0.0\"]}\n";
+		os << "{\"id\": 2, \"method\": \"mining.authorize\", \"params\": [\"" << _pool.user << "\",\"" << _pool.pass << "\"]}\n";
+		break;
+	default:
+		os << "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": []}\n";
+		os << "{\"id\": 2, \"method\": \"mining.authorize\", \"params\": [\"" << _pool.user << "\",\"" << _pool.pass << "\"]}\n";
+		break;
+	}
+	return os.str();
+}
+
+double msSince(chrono::steady_clock::time_point _t)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - _t).count();
+}
+
+}
+
+const unsigned StratumPools::c_probeTimeout;
+
+void PoolHealth::record(Metric _metric, double _ms)
+{
+	double& avg = _metric == Connect ? connectMs : _metric == RoundTrip ? roundTripMs : firstJobMs;
+	avg = avg ? avg + c_weight * (_ms - avg) : _ms;
+	if (_metric == FirstJob)
+	{
+		sessions++;
+		failures = 0;
+	}
+}
+
+void PoolHealth::recordShare(bool _accepted, bool _stale)
+{
+	accepted *= c_decay;
+	rejected *= c_decay;
+	stale *= c_decay;
+	(_accepted ? accepted : rejected) += 1;
+	if (_stale)
+		stale += 1;
+}
+
+double PoolHealth::rejectRatio() const
+{
+	return rejected / (accepted + rejected + c_prior);
+}
+
+double PoolHealth::staleRatio() const
+{
+	return stale / (accepted + rejected + c_prior);
+}
+
+bool PoolHealth::healthy() const
+{
+	return sessions && failures < c_maxFailures;
+}
+
+double PoolHealth::score() const
+{
+	if (!healthy())
+		return numeric_limits<double>::infinity();
+	return (connectMs + roundTripMs + firstJobMs) * (1 + 5 * (rejectRatio() + staleRatio()));
+}
+
+ostream& dev::eth::operator<<(ostream& _out, PoolHealth const& _h)
+{
+	if (!_h.sessions)
+		return _out << (_h.failures ? "unreachable" : "not measured");
+	_out << fixed << setprecision(1)
+		<< "connect " << _h.connectMs << "ms, round trip " << _h.roundTripMs << "ms, first job " << _h.firstJobMs << "ms"
+		<< ", rejected " << _h.rejectRatio() * 100 << "%, stale " << _h.staleRatio() * 100 << "%";
+	if (!_h.healthy())
+		return _out << ", failing";
+	return _out << ", score " << setprecision(0) << _h.score();
+}
+
+size_t StratumPools::add(cred_t const& _pool)
+{
+	Guard l(x_pools);
+	m_pools.emplace_back();
+	m_pools.back().cred = _pool;
+	return m_pools.size() - 1;
+}
+
+PoolHealth StratumPools::health(size_t _i) const
+{
+	Guard l(x_pools);
+	return m_pools[_i].health;
+}
+
+void StratumPools::setActive(size_t _i)
+{
+	Guard l(x_pools);
+	m_active = _i;
+	m_candidateRounds = 0;
+}
+
+void StratumPools::record(size_t _i, PoolHealth::Metric _metric, double _ms)
+{
+	Guard l(x_pools);
+	m_pools[_i].health.record(_metric, _ms);
+}
+
+void StratumPools::recordShare(size_t _i, bool _accepted, bool _stale)
+{
+	Guard l(x_pools);
+	m_pools[_i].health.recordShare(_accepted, _stale);
+}
+
+void StratumPools::recordFailure(size_t _i)
+{
+	Guard l(x_pools);
+	m_pools[_i].health.failures++;
+}
+
+size_t StratumPools::next(size_t _from) const
+{
+	Guard l(x_pools);
+	size_t best = _from;
+	double bestScore = numeric_limits<double>::infinity();
+	for (size_t i = 0; i < m_pools.size(); ++i)
+		if (i != _from && m_pools[i].health.score() < bestScore)
+		{
+			best = i;
+			bestScore = m_pools[i].health.score();
+		}
+	return best != _from ? best : (_from + 1) % m_pools.size();
+}
+
+size_t StratumPools::choose()
+{
+	size_t best = m_active;
+	double bestScore = numeric_limits<double>::infinity();
+	for (size_t i = 0; i < m_pools.size(); ++i)
+		if (i != m_active && m_pools[i].health.score() < bestScore)
+		{
+			best = i;
+			bestScore = m_pools[i].health.score();
+		}
+
+	// A failing active pool is left by the client's reconnect logic.
+	PoolHealth const& active = m_pools[m_active].health;
+	if (best == m_active || !active.healthy())
+	{
+		m_candidateRounds = 0;
+		return m_active;
+	}
+
+	if (active.staleRatio() > c_maxStaleRatio && m_pools[best].health.staleRatio() < active.staleRatio())
+		return best;
+
+	if (bestScore < active.score() * (1 - c_switchMargin))
+	{
+		if (best != m_candidate)
+		{
+			m_candidate = best;
+			m_candidateRounds = 0;
+		}
+		if (++m_candidateRounds >= c_switchRounds)
+			return best;
+	}
+	else
+		m_candidateRounds = 0;
+	return m_active;
+}
+
+void StratumPools::startProbing(unsigned _seconds, function<void(size_t)> const& _onSwitch)
+{
+	if (m_prober.joinable() || !_seconds)
+		return;
+	m_onSwitch = _onSwitch;
+	m_stop = false;
+	m_prober = thread([=]() { probeLoop(_seconds); });
+}
+
+void StratumPools::stopProbing()
+{
+	{
+		Guard l(x_stop);
+		m_stop = true;
+	}
+	m_stopped.notify_all();
+	if (m_prober.joinable())
+		m_prober.join();
+}
+
+void StratumPools::probeLoop(unsigned _seconds)
+{
+	dev::setThreadName("prober");
+	while (true)
+	{
+		for (size_t i = 0; i < size(); ++i)
+		{
+			cred_t pool;
+			{
+				Guard l(x_pools);
+				if (i == m_active || m_pools[i].cred.host == "exit")
+					continue;
+				pool = m_pools[i].cred;
+			}
+
+			PoolHealth sample;
+			bool ok = probe(pool, sample);
+
+			Guard l(x_pools);
+			PoolHealth& h = m_pools[i].health;
+			if (ok)
+			{
+				h.record(PoolHealth::Connect, sample.connectMs);
+				if (sample.roundTripMs)
+					h.record(PoolHealth::RoundTrip, sample.roundTripMs);
+				h.record(PoolHealth::FirstJob, sample.firstJobMs);
+			}
+			else
+				h.failures++;
+		}
+
+		size_t active;
+		size_t to;
+		{
+			Guard l(x_pools);
+			active = m_active;
+			to = choose();
+			if (to != active)
+				cnote << "Pool" << m_pools[to].cred.host << "(" << m_pools[to].health << ") ranks above" << m_pools[active].cred.host << "(" << m_pools[active].health << ")";
+		}
+		if (to != active && m_onSwitch)
+			m_onSwitch(to);
+
+		unique_lock<mutex> l(x_stop);
+		if (m_stopped.wait_for(l, chrono::seconds(_seconds), [&]() { return m_stop; }))
+			return;
+	}
+}
+
+bool StratumPools::probe(cred_t const& _pool, PoolHealth& o_sample) const
+{
+	boost::asio::io_service io;
+	tcp::socket socket(io);
+	boost::system::error_code ec;
+	vector<tcp::endpoint> endpoints = ResolverCache::get().resolve(io, _pool.host, _pool.port, ec);
+	if (ec)
+		return false;
+
+	// A probe that runs out of time is abandoned with whatever is still pending.
+	boost::asio::deadline_timer timeout(io, boost::posix_time::seconds(c_probeTimeout));
+	timeout.async_wait([&](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			io.stop();
+	});
+
+	string login = loginRequest(m_protocol, _pool, m_email);
+	boost::asio::streambuf response;
+	auto sent = chrono::steady_clock::now();
+	bool gotJob = false;
+
+	function<void()> readLine;
+	readLine = [&]()
+	{
+		boost::asio::async_read_until(socket, response, "\n", [&](boost::system::error_code const& _ec, size_t _n)
+		{
+			if (_ec)
+				return;
+			char const* line = boost::asio::buffer_cast<char const*>(response.data());
+			StratumMessage msg;
+			int id = 0;
+			if (StratumParser::parse(line, line + _n, m_protocol, msg))
+			{
+				if (msg.kind == StratumMessage::Notify)
+				{
+					o_sample.firstJobMs = msSince(sent);
+					gotJob = true;
+					timeout.cancel(ec);
+					socket.close(ec);
+					return;
+				}
+				id = msg.id;
+			}
+			else
+			{
+				// Subscribe results are structured; only the id is of interest here.
+				Json::Value v;
+				if (Json::Reader().parse(string(line, _n), v) && v.isObject() && v.get("id", Json::Value::null).isIntegral())
+					id = v.get("id", 0).asInt();
+			}
+			if (id == 1 && !o_sample.roundTripMs)
+				o_sample.roundTripMs = msSince(sent);
+			response.consume(_n);
+			readLine();
+		});
+	};
+
+	ConnectRace::start(io, socket, endpoints, [&](boost::system::error_code const& _ec, tcp::endpoint const&, double _connectMs)
+	{
+		if (_ec)
+		{
+			ResolverCache::get().forget(_pool.host, _pool.port);
+			return;
+		}
+		o_sample.connectMs = _connectMs;
+		sent = chrono::steady_clock::now();
+		boost::asio::async_write(socket, boost::asio::buffer(login), [&](boost::system::error_code const& _writeEc, size_t)
+		{
+			if (!_writeEc)
+				readLine();
+		});
+	});
+
+	io.run();
+	return gotJob;
+}
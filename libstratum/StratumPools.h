@@ -0,0 +1,152 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumPools.h
+ * Pool list with health scores kept up to date by a background prober.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <libdevcore/Guards.h>
+#include <libethcore/Miner.h>
+#include "StratumRequests.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/// What is known about how well a pool serves us. Times are moving averages in ms.
+struct PoolHealth
+{
+	enum Metric
+	{
+		Connect,		///< TCP connect.
+		RoundTrip,		///< Request to response.
+		FirstJob		///< Login to the first job.
+	};
+
+	double connectMs = 0;
+	double roundTripMs = 0;
+	double firstJobMs = 0;
+	unsigned sessions = 0;	///< Logins that delivered a job.
+	unsigned failures = 0;	///< Consecutive failed connections or probes.
+	double accepted = 0;	///< Share counts, decaying so recent shares weigh most.
+	double rejected = 0;
+	double stale = 0;
+
+	void record(Metric _metric, double _ms);
+	void recordShare(bool _accepted, bool _stale);
+
+	double rejectRatio() const;
+	double staleRatio() const;
+	bool healthy() const;
+
+	/**
+	 * @brief Lower is better: the measured delays, inflated by the rejected and
+	 * stale share ratios.
+	 * @returns infinity for pools that are failing or were never measured.
+	 */
+	double score() const;
+};
+
+std::ostream& operator<<(std::ostream& _out, PoolHealth const& _h);
+
+/**
+ * @brief The stratum pools to mine on, ranked by health.
+ * The client reports what it measures on the active pool; a prober thread
+ * periodically logs in to every other pool and measures the connect time, the
+ * subscribe round trip and how long the first job takes. When another pool is
+ * consistently faster, or the active one's stale rate degrades, the switch
+ * handler is told to move.
+ * @threadsafe
+ */
+class StratumPools
+{
+public:
+	StratumPools(int _protocol, std::string const& _email): m_protocol(_protocol), m_email(_email) {}
+	~StratumPools() { stopProbing(); }
+
+	/// Adds a pool; @returns its index. References to pools stay valid.
+	size_t add(cred_t const& _pool);
+	size_t size() const { Guard l(x_pools); return m_pools.size(); }
+	cred_t const& at(size_t _i) const { Guard l(x_pools); return m_pools[_i].cred; }
+	PoolLatency& latency(size_t _i) { Guard l(x_pools); return m_pools[_i].latency; }
+	PoolLatency const& latency(size_t _i) const { Guard l(x_pools); return m_pools[_i].latency; }
+	PoolHealth health(size_t _i) const;
+
+	/// The pool the client is on; it is not probed.
+	void setActive(size_t _i);
+
+	void record(size_t _i, PoolHealth::Metric _metric, double _ms);
+	void recordShare(size_t _i, bool _accepted, bool _stale);
+	void recordFailure(size_t _i);
+
+	/// @returns the pool to fall back to when @a _from fails: the best healthy one, else the next in the list.
+	size_t next(size_t _from) const;
+
+	/**
+	 * @brief Starts probing every @a _seconds. @a _onSwitch is called from the
+	 * prober thread with the pool to move to.
+	 */
+	void startProbing(unsigned _seconds, std::function<void(size_t)> const& _onSwitch);
+	void stopProbing();
+
+private:
+	struct Pool
+	{
+		cred_t cred;
+		PoolHealth health;
+		PoolLatency latency;
+	};
+
+	/// A candidate must beat the active pool's score by this fraction...
+	static constexpr double c_switchMargin = 0.2;
+	/// ...in this many consecutive probe rounds.
+	static const unsigned c_switchRounds = 3;
+	/// Stale ratio at which the active pool is left for any healthy pool with fewer stales.
+	static constexpr double c_maxStaleRatio = 0.1;
+	static const unsigned c_probeTimeout = 10;
+
+	void probeLoop(unsigned _seconds);
+	bool probe(cred_t const& _pool, PoolHealth& o_sample) const;
+	/// @returns the pool the active one should be left for, or the active one. Caller holds x_pools.
+	size_t choose();
+
+	int m_protocol;
+	std::string m_email;
+
+	mutable Mutex x_pools;
+	std::deque<Pool> m_pools;
+	size_t m_active = 0;
+	size_t m_candidate = 0;
+	unsigned m_candidateRounds = 0;
+
+	std::function<void(size_t)> m_onSwitch;
+	std::thread m_prober;
+	Mutex x_stop;
+	std::condition_variable m_stopped;
+	bool m_stop = false;
+};
+
+}
+}
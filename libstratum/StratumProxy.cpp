@@ -0,0 +1,353 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumProxy.cpp
+ */
+
+#include "StratumProxy.h"
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+#include <json/json.h>
+#include <libdevcore/Log.h>
+#include "EthStratumClient.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+
+namespace
+{
+
+/// The difficulty whose target, as the clients' diffToTarget() computes it, is @a _boundary.
+double difficulty(h256 const& _boundary)
+{
+	double target = 0;
+	for (unsigned i = 0; i < h256::size; ++i)
+		target = target * 256 + _boundary[i];
+	if (target == 0)
+		return 0;
+	// diffToTarget() yields 0xffff0000 * 2^192 / difficulty; rounding up a hair
+	// keeps the downstream target from ending up above the pool's.
+	return ldexp(4294901760.0, 192) / target * (1 + 1e-9);
+}
+
+string resultReply(unsigned _id, char const* _result)
+{
+	return "{\"id\": " + to_string(_id) + ", \"result\": " + _result + ", \"error\": null}\n";
+}
+
+string errorReply(unsigned _id, int _code, char const* _message)
+{
+	return "{\"id\": " + to_string(_id) + ", \"result\": null, \"error\": [" + to_string(_code) + ", \"" + _message + "\", null]}\n";
+}
+
+}
+
+struct StratumProxy::Session
+{
+	Session(boost::asio::io_service& _io): socket(_io) {}
+
+	tcp::socket socket;
+	boost::asio::streambuf buffer;
+	deque<Message> queue;		///< Being written, front first.
+	unsigned slot = 0;
+	bool authorized = false;
+	bool closed = false;
+	string worker;
+};
+
+const unsigned StratumProxy::c_slotDigits;
+
+StratumProxy::StratumProxy(EthStratumClient& _upstream, string const& _address, unsigned short _port):
+	m_upstream(_upstream),
+	m_acceptor(m_io),
+	m_sessions(0),
+	m_forwarded(0),
+	m_refused(0)
+{
+	tcp::endpoint endpoint(boost::asio::ip::address::from_string(_address), _port);
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen();
+	cnote << "Stratum proxy listening on" << _address + ":" + to_string(_port);
+	accept();
+	m_thread = thread([this]()
+	{
+		dev::setThreadName("proxy");
+		m_io.run();
+	});
+}
+
+StratumProxy::~StratumProxy()
+{
+	m_io.stop();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void StratumProxy::setWork(WorkPackage const& _work)
+{
+	WorkPackage work = _work;
+	m_io.post([this, work]() { newJob(work); });
+}
+
+void StratumProxy::accept()
+{
+	auto s = make_shared<Session>(m_io);
+	m_acceptor.async_accept(s->socket, [this, s](boost::system::error_code const& _ec)
+	{
+		if (_ec == boost::asio::error::operation_aborted)
+			return;
+		if (!_ec)
+		{
+			unsigned slot = 0;
+			while (slot < (1u << (4 * c_slotDigits)) && m_slots.count(slot))
+				slot++;
+			boost::system::error_code ec;
+			if (slot == (1u << (4 * c_slotDigits)))
+			{
+				cwarn << "Stratum proxy is full, refusing" << s->socket.remote_endpoint(ec);
+				s->socket.close(ec);
+			}
+			else
+			{
+				s->slot = slot;
+				m_slots[slot] = s;
+				m_sessions = m_slots.size();
+				// Jobs are small and latency sensitive; do not let Nagle hold them back.
+				s->socket.set_option(tcp::no_delay(true), ec);
+				cnote << "Miner connected from" << s->socket.remote_endpoint(ec);
+				read(s);
+			}
+		}
+		accept();
+	});
+}
+
+void StratumProxy::newJob(WorkPackage const& _work)
+{
+	// The upstream extranonce is the top exSizeBits of the start nonce.
+	string upstreamExtranonce;
+	if (_work.exSizeBits > 0)
+	{
+		char hex[17];
+		snprintf(hex, sizeof(hex), "%016" PRIx64, _work.startNonce);
+		upstreamExtranonce.assign(hex, min(_work.exSizeBits / 4, 16 - int(c_slotDigits)));
+	}
+	bool reslot = upstreamExtranonce != m_upstreamExtranonce;
+	m_upstreamExtranonce = upstreamExtranonce;
+
+	bool retarget = _work.boundary != m_current.boundary || !m_difficulty;
+	bool reseed = _work.seed != m_current.seed;
+	m_previous = move(m_current);
+	m_current = Job();
+	ostringstream id;
+	id << hex << ++m_nextJob;
+	m_current.id = id.str();
+	m_current.header = _work.header;
+	m_current.seed = _work.seed;
+	m_current.boundary = _work.boundary;
+
+	if (retarget)
+	{
+		ostringstream os;
+		os << "{\"id\": null, \"method\": \"mining.set_difficulty\", \"params\": [" << setprecision(17) << difficulty(_work.boundary) << "]}\n";
+		m_difficulty = make_shared<string const>(os.str());
+	}
+	m_notify = make_shared<string const>("{\"id\": null, \"method\": \"mining.notify\", \"params\": [\"" + m_current.id + "\",\"" + _work.seed.hex() + "\",\"" + _work.header.hex() + "\",true]}\n");
+
+	// One rendering of the job is shared by every session's write queue.
+	for (auto const& slot: m_slots)
+	{
+		SessionPtr const& s = slot.second;
+		if (reslot)
+			send(s, make_shared<string const>("{\"id\": null, \"method\": \"mining.set_extranonce\", \"params\": [\"" + extranonce(s) + "\"]}\n"));
+		if (!s->authorized)
+			continue;
+		if (retarget)
+			send(s, m_difficulty);
+		send(s, m_notify);
+	}
+
+	// Building the light cache takes a while; better now than on the first share of the epoch.
+	if (reseed)
+		try
+		{
+			EthashAux::light(_work.seed);
+		}
+		catch (...)
+		{
+			cwarn << "Cannot build the light cache to verify shares with";
+		}
+}
+
+void StratumProxy::read(SessionPtr const& _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\n", [this, _s](boost::system::error_code const& _ec, size_t _n)
+	{
+		if (_ec)
+		{
+			close(_s);
+			return;
+		}
+		string line(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _n);
+		_s->buffer.consume(_n);
+		process(_s, line);
+		if (!_s->closed)
+			read(_s);
+	});
+}
+
+void StratumProxy::process(SessionPtr const& _s, string const& _line)
+{
+	Json::Value request;
+	if (!Json::Reader().parse(_line, request) || !request.isObject())
+	{
+		cwarn << "Malformed request from miner, disconnecting";
+		close(_s);
+		return;
+	}
+	// Miners are not trusted to send the right types: the accessors throw on
+	// anything else, and nothing above this would catch it.
+	unsigned id = request.get("id", 0).isUInt() ? request.get("id", 0).asUInt() : 0;
+	Json::Value methodValue = request.get("method", "");
+	string method = methodValue.isString() ? methodValue.asString() : "";
+	Json::Value params = request.get("params", Json::Value::null);
+	if (!params.isArray())
+		params = Json::Value(Json::arrayValue);
+	auto param = [&](Json::ArrayIndex _i)
+	{
+		Json::Value p = params.get(_i, "");
+		return p.isString() ? p.asString() : string();
+	};
+
+	if (method == "mining.subscribe")
+	{
+		char session[9];
+		snprintf(session, sizeof(session), "%08x", _s->slot);
+		string result = string("[[\"mining.notify\",\"") + session + "\",\"EthereumStratum/1.0.0\"],\"" + extranonce(_s) + "\"]";
+		send(_s, make_shared<string const>(resultReply(id, result.c_str())));
+	}
+	else if (method == "mining.extranonce.subscribe" || method == "eth_submitHashrate")
+		send(_s, make_shared<string const>(resultReply(id, "true")));
+	else if (method == "mining.authorize")
+	{
+		_s->worker = param(0);
+		_s->authorized = true;
+		cnote << "Authorized miner" << _s->worker;
+		send(_s, make_shared<string const>(resultReply(id, "true")));
+		if (m_notify)
+		{
+			send(_s, m_difficulty);
+			send(_s, m_notify);
+		}
+	}
+	else if (method == "mining.submit")
+	{
+		if (!_s->authorized)
+			send(_s, make_shared<string const>(errorReply(id, 24, "Unauthorized worker")));
+		else
+			submit(_s, id, param(1), param(2));
+	}
+	else
+		send(_s, make_shared<string const>(errorReply(id, 20, "Unsupported method")));
+}
+
+void StratumProxy::submit(SessionPtr const& _s, unsigned _id, string const& _job, string const& _nonce)
+{
+	auto refuse = [&](int _code, char const* _message)
+	{
+		m_refused++;
+		cwarn << "Share from" << _s->worker << "refused:" << _message;
+		send(_s, make_shared<string const>(errorReply(_id, _code, _message)));
+	};
+
+	Job* job = !_job.empty() && _job == m_current.id ? &m_current : !_job.empty() && _job == m_previous.id ? &m_previous : nullptr;
+	if (!job)
+		return refuse(21, "Job not found");
+
+	string nonceHex = extranonce(_s) + _nonce;
+	if (nonceHex.size() != 16 || nonceHex.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+		return refuse(20, "Malformed nonce");
+	uint64_t nonce = stoull(nonceHex, nullptr, 16);
+	if (!job->nonces.insert(nonce).second)
+		return refuse(22, "Duplicate share");
+
+	Result result = EthashAux::eval(job->seed, job->header, nonce);
+	if (result.value >= job->boundary)
+		return refuse(23, "Low difficulty share");
+
+	if (!m_upstream.isConnected())
+		return refuse(20, "Pool not connected");
+	Solution solution{nonce, result.mixHash, job->header, job->seed, job->boundary, result, 0, 0};
+	if (!m_upstream.submit(solution))
+		return refuse(21, "Job not found");
+
+	m_forwarded++;
+	cnote << "Share from" << _s->worker << "forwarded";
+	send(_s, make_shared<string const>(resultReply(_id, "true")));
+}
+
+void StratumProxy::send(SessionPtr const& _s, Message const& _m)
+{
+	if (_s->closed)
+		return;
+	_s->queue.push_back(_m);
+	if (_s->queue.size() == 1)
+		write(_s);
+}
+
+void StratumProxy::write(SessionPtr const& _s)
+{
+	boost::asio::async_write(_s->socket, boost::asio::buffer(*_s->queue.front()), [this, _s](boost::system::error_code const& _ec, size_t)
+	{
+		if (_ec || _s->closed)
+		{
+			close(_s);
+			return;
+		}
+		_s->queue.pop_front();
+		if (!_s->queue.empty())
+			write(_s);
+	});
+}
+
+void StratumProxy::close(SessionPtr const& _s)
+{
+	if (_s->closed)
+		return;
+	_s->closed = true;
+	boost::system::error_code ec;
+	_s->socket.close(ec);
+	auto it = m_slots.find(_s->slot);
+	if (it != m_slots.end() && it->second == _s)
+		m_slots.erase(it);
+	m_sessions = m_slots.size();
+	cnote << "Miner" << _s->worker << "disconnected";
+}
+
+string StratumProxy::extranonce(SessionPtr const& _s) const
+{
+	char slot[c_slotDigits + 1];
+	snprintf(slot, sizeof(slot), "%0*x", int(c_slotDigits), _s->slot);
+	return m_upstreamExtranonce + slot;
+}
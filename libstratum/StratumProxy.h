@@ -0,0 +1,108 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumProxy.h
+ * Local stratum server that shares one pool session between many miners.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <libethcore/EthashAux.h>
+
+class EthStratumClient;
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Serves the jobs of one upstream client to downstream miners speaking
+ * EthereumStratum/1.0.0, so a farm of rigs shares a single pool session.
+ * Every downstream gets its own extranonce, the upstream's one followed by a
+ * slot number, so no two rigs search the same nonces. Shares are evaluated
+ * with EthashAux before they are submitted upstream; ones that do not meet
+ * the pool's target never leave the proxy.
+ * @threadsafe
+ */
+class StratumProxy
+{
+public:
+	StratumProxy(EthStratumClient& _upstream, std::string const& _address, unsigned short _port);
+	~StratumProxy();
+
+	/// Fans a job out to the downstream miners. Called from the upstream client's thread.
+	void setWork(WorkPackage const& _work);
+
+	unsigned sessions() const { return m_sessions; }
+	unsigned forwarded() const { return m_forwarded; }
+	unsigned refused() const { return m_refused; }
+
+private:
+	struct Session;
+	typedef std::shared_ptr<Session> SessionPtr;
+	typedef std::shared_ptr<std::string const> Message;
+
+	struct Job
+	{
+		std::string id;
+		h256 header;
+		h256 seed;
+		h256 boundary;
+		std::set<uint64_t> nonces;	///< Submitted so far, to refuse duplicates.
+	};
+
+	/// Hex digits of extranonce a slot adds to the upstream one; bounds the number of downstreams.
+	static const unsigned c_slotDigits = 2;
+
+	void accept();
+	void newJob(WorkPackage const& _work);
+	void read(SessionPtr const& _s);
+	void process(SessionPtr const& _s, std::string const& _line);
+	void submit(SessionPtr const& _s, unsigned _id, std::string const& _job, std::string const& _nonce);
+	void send(SessionPtr const& _s, Message const& _m);
+	void write(SessionPtr const& _s);
+	void close(SessionPtr const& _s);
+	std::string extranonce(SessionPtr const& _s) const;
+
+	EthStratumClient& m_upstream;
+
+	// Everything below is only touched on m_io's thread.
+	boost::asio::io_service m_io;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	std::map<unsigned, SessionPtr> m_slots;
+	std::string m_upstreamExtranonce;
+	Job m_current;
+	Job m_previous;
+	unsigned m_nextJob = 0;
+	Message m_difficulty;	///< The latest set_difficulty and notify, for miners that log in between jobs.
+	Message m_notify;
+
+	std::atomic<unsigned> m_sessions;
+	std::atomic<unsigned> m_forwarded;
+	std::atomic<unsigned> m_refused;
+	std::thread m_thread;
+};
+
+}
+}
@@ -0,0 +1,45 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumReactor.cpp
+ */
+
+#include "StratumReactor.h"
+#include <libdevcore/Log.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+StratumReactor::StratumReactor():
+	m_work(new boost::asio::io_service::work(m_service))
+{
+	m_thread = thread([this]()
+	{
+		dev::setThreadName("stratum");
+		m_service.run();
+	});
+}
+
+void StratumReactor::stop()
+{
+	Guard l(x_stop);
+	if (!m_thread.joinable())
+		return;
+	m_work.reset();
+	m_service.stop();
+	m_thread.join();
+}
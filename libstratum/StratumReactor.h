@@ -0,0 +1,62 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumReactor.h
+ * The I/O thread that stratum sessions run on.
+ */
+
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <boost/asio.hpp>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief An io_service and the thread running it, shared by any number of
+ * stratum sessions. Each session keeps its state on its own strand, so one
+ * thread can drive the primary pool, a standby failover and a split pool.
+ * @threadsafe
+ */
+class StratumReactor
+{
+public:
+	StratumReactor();
+	~StratumReactor() { stop(); }
+
+	boost::asio::io_service& service() { return m_service; }
+
+	/**
+	 * @brief Stops the thread; handlers that have not run by then never will.
+	 * Called by the destructor, once the last session sharing the reactor is gone.
+	 * Must not be called from the reactor's own thread.
+	 */
+	void stop();
+
+private:
+	boost::asio::io_service m_service;
+	std::unique_ptr<boost::asio::io_service::work> m_work;	///< Keeps the thread running while no operation is pending.
+	std::thread m_thread;
+	Mutex x_stop;
+};
+
+}
+}
@@ -0,0 +1,113 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumRequests.cpp
+ */
+
+#include "StratumRequests.h"
+#include <climits>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+void PoolLatency::record(StratumRequest const& _r, chrono::steady_clock::time_point _now)
+{
+	auto rtt = _now - _r.sentAt;
+	switch (_r.kind)
+	{
+	case StratumRequest::Subscribe:
+		subscribe.record(rtt);
+		break;
+	case StratumRequest::Authorize:
+		authorize.record(rtt);
+		break;
+	case StratumRequest::Submit:
+		submit.record(rtt);
+		break;
+	case StratumRequest::GetWork:
+		getWork.record(rtt);
+		break;
+	case StratumRequest::Heartbeat:
+		heartbeat.record(rtt);
+		break;
+	default:
+		break;
+	}
+}
+
+ostream& dev::eth::operator<<(ostream& _out, PoolLatency const& _l)
+{
+	return _out << "subscribe " << _l.subscribe << ", authorize " << _l.authorize
+		<< ", submit " << _l.submit << ", getWork " << _l.getWork
+		<< ", heartbeat " << _l.heartbeat << ", tcp " << _l.tcp;
+}
+
+unsigned StratumRequests::nextId()
+{
+	// Ids stay positive ints, since that is how the responses are parsed; 0 is
+	// left out as pools use it (or null) for notifications.
+	if (++m_nextId > INT_MAX)
+		m_nextId = 1;
+	return m_nextId;
+}
+
+unsigned StratumRequests::add(StratumRequest::Kind _kind, bool _stale, uint64_t _generation)
+{
+	Guard l(x_pending);
+	unsigned id = nextId();
+	StratumRequest& r = m_pending[id];
+	r.kind = _kind;
+	r.sentAt = chrono::steady_clock::now();
+	r.stale = _stale;
+	r.generation = _generation;
+	if (m_pending.size() > c_maxPending)
+		m_pending.erase(m_pending.begin());
+	return id;
+}
+
+unsigned StratumRequests::untracked()
+{
+	Guard l(x_pending);
+	return nextId();
+}
+
+bool StratumRequests::peek(int _id, StratumRequest::Kind& o_kind) const
+{
+	Guard l(x_pending);
+	auto it = m_pending.find(unsigned(_id));
+	if (_id <= 0 || it == m_pending.end())
+		return false;
+	o_kind = it->second.kind;
+	return true;
+}
+
+bool StratumRequests::take(int _id, StratumRequest& o_request)
+{
+	Guard l(x_pending);
+	auto it = m_pending.find(unsigned(_id));
+	if (_id <= 0 || it == m_pending.end())
+		return false;
+	o_request = it->second;
+	m_pending.erase(it);
+	return true;
+}
+
+void StratumRequests::clear()
+{
+	Guard l(x_pending);
+	m_pending.clear();
+}
@@ -0,0 +1,105 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumRequests.h
+ * Outstanding stratum requests and pool round-trip times.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <libdevcore/Guards.h>
+#include <libdevcore/LatencyHistogram.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct StratumRequest
+{
+	enum Kind
+	{
+		Subscribe,				///< mining.subscribe, or eth_submitLogin on eth-proxy.
+		ExtranonceSubscribe,
+		Authorize,
+		Submit,
+		GetWork,
+		Hashrate,
+		Heartbeat,				///< Liveness check on an idle connection; any response will do.
+		SuggestDifficulty,		///< mining.suggest_difficulty or mining.suggest_target.
+		None					///< Not a response to a request of ours.
+	};
+
+	Kind kind = None;
+	std::chrono::steady_clock::time_point sentAt;
+	bool stale = false;			///< Submit: the share solves the previous job.
+	uint64_t generation = 0;	///< Submit: Farm generation of the solved work package.
+};
+
+/// Round-trip times measured against one pool.
+struct PoolLatency
+{
+	LatencyHistogram subscribe;
+	LatencyHistogram authorize;
+	LatencyHistogram submit;
+	LatencyHistogram getWork;
+	LatencyHistogram heartbeat;
+	LatencyHistogram tcp;		///< The kernel's smoothed RTT estimate, sampled on each heartbeat tick.
+
+	void record(StratumRequest const& _r, std::chrono::steady_clock::time_point _now);
+};
+
+std::ostream& operator<<(std::ostream& _out, PoolLatency const& _l);
+
+/**
+ * @brief Gives every request its own id and remembers it until the pool answers,
+ * so a response is attributed to the request it belongs to.
+ * Requests that are never answered are dropped oldest first once c_maxPending
+ * are outstanding, and all of them on reconnect.
+ * @threadsafe
+ */
+class StratumRequests
+{
+public:
+	/// Registers a request; @returns its id.
+	unsigned add(StratumRequest::Kind _kind, bool _stale = false, uint64_t _generation = 0);
+
+	/// @returns an id for a request whose response is of no interest.
+	unsigned untracked();
+
+	/// Looks up an outstanding request without removing it.
+	bool peek(int _id, StratumRequest::Kind& o_kind) const;
+
+	/// Removes an outstanding request; @returns false if the id is unknown.
+	bool take(int _id, StratumRequest& o_request);
+
+	void clear();
+
+private:
+	static const size_t c_maxPending = 256;
+
+	unsigned nextId();
+
+	mutable Mutex x_pending;
+	std::map<unsigned, StratumRequest> m_pending;
+	unsigned m_nextId = 0;
+};
+
+}
+}
@@ -0,0 +1,115 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SubmitTemplate.cpp
+ */
+
+#include "SubmitTemplate.h"
+#include <cstring>
+#include <libethcore/Miner.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+char const c_hexDigits[] = "0123456789abcdef";
+
+void writeHex(char* o_out, byte const* _data, size_t _size)
+{
+	for (size_t i = 0; i < _size; ++i)
+	{
+		*o_out++ = c_hexDigits[_data[i] >> 4];
+		*o_out++ = c_hexDigits[_data[i] & 0xf];
+	}
+}
+
+/// Appends @a _digits zeros and returns their offset.
+size_t placeholder(string& io_s, size_t _digits)
+{
+	size_t at = io_s.size();
+	io_s.append(_digits, '0');
+	return at;
+}
+
+}
+
+void SubmitTemplate::render(int _protocol, string const& _user, string const& _worker, string const& _job, h256 const& _header, unsigned _extraNonceHexSize)
+{
+	m_request.clear();
+	m_nonceSkip = 0;
+	m_mixAt = string::npos;
+	size_t headerAt;
+
+	switch (_protocol)
+	{
+	case STRATUM_PROTOCOL_STRATUM:
+		m_request.append("{\"id\": , \"method\": \"mining.submit\", \"params\": [\"").append(_user).append("\",\"").append(_job).append("\",\"0x");
+		m_nonceAt = placeholder(m_request, 16);
+		m_request.append("\",\"0x");
+		headerAt = placeholder(m_request, 64);
+		m_request.append("\",\"0x");
+		m_mixAt = placeholder(m_request, 64);
+		m_request.append("\"]}\n");
+		writeHex(&m_request[headerAt], _header.data(), h256::size);
+		break;
+	case STRATUM_PROTOCOL_ETHPROXY:
+		m_request.append("{\"id\": , \"worker\":\"").append(_worker).append("\", \"method\": \"eth_submitWork\", \"params\": [\"0x");
+		m_nonceAt = placeholder(m_request, 16);
+		m_request.append("\",\"0x");
+		headerAt = placeholder(m_request, 64);
+		m_request.append("\",\"0x");
+		m_mixAt = placeholder(m_request, 64);
+		m_request.append("\"]}\n");
+		writeHex(&m_request[headerAt], _header.data(), h256::size);
+		break;
+	case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
+		m_nonceSkip = min(_extraNonceHexSize, 16u);
+		m_request.append("{\"id\": , \"method\": \"mining.submit\", \"params\": [\"").append(_user).append("\",\"").append(_job).append("\",\"");
+		m_nonceAt = placeholder(m_request, 16 - m_nonceSkip);
+		m_request.append("\"]}\n");
+		break;
+	}
+}
+
+void SubmitTemplate::write(unsigned _id, uint64_t _nonce, h256 const& _mixHash, string& o_request) const
+{
+	char id[10];
+	unsigned idDigits = 0;
+	do
+		id[sizeof(id) - ++idDigits] = char('0' + _id % 10);
+	while ((_id /= 10) && idDigits < sizeof(id));
+
+	o_request.assign(m_request, 0, c_idAt);
+	o_request.append(id + sizeof(id) - idDigits, idDigits);
+	o_request.append(m_request, c_idAt, string::npos);
+
+	char* nonce = &o_request[m_nonceAt + idDigits];
+	for (unsigned i = m_nonceSkip; i < 16; ++i)
+		*nonce++ = c_hexDigits[(_nonce >> (60 - 4 * i)) & 0xf];
+	if (m_mixAt != string::npos)
+		writeHex(&o_request[m_mixAt + idDigits], _mixHash.data(), h256::size);
+}
+
+void SubmitTemplate::swap(SubmitTemplate& _other)
+{
+	m_request.swap(_other.m_request);
+	std::swap(m_nonceAt, _other.m_nonceAt);
+	std::swap(m_nonceSkip, _other.m_nonceSkip);
+	std::swap(m_mixAt, _other.m_mixAt);
+}
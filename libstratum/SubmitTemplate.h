@@ -0,0 +1,65 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SubmitTemplate.h
+ * Share submission requests rendered once per job.
+ */
+
+#pragma once
+
+#include <string>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief The submit request of one job, with the nonce and the mix hash left
+ * as zero-filled placeholders and the request id left out.
+ * It is rendered when the job arrives; a share then only costs a copy and
+ * writing the three values in place.
+ */
+class SubmitTemplate
+{
+public:
+	/**
+	 * @brief Renders the request for a job.
+	 * @param _protocol One of the STRATUM_PROTOCOL_* values.
+	 * @param _worker The eth-proxy worker name.
+	 * @param _extraNonceHexSize EthereumStratum only: leading nonce digits owned by the pool.
+	 */
+	void render(int _protocol, std::string const& _user, std::string const& _worker, std::string const& _job, h256 const& _header, unsigned _extraNonceHexSize);
+
+	/// Writes the complete request for the given share to @a o_request, reusing its capacity.
+	void write(unsigned _id, uint64_t _nonce, h256 const& _mixHash, std::string& o_request) const;
+
+	void clear() { m_request.clear(); }
+	bool empty() const { return m_request.empty(); }
+	void swap(SubmitTemplate& _other);
+
+private:
+	static const size_t c_idAt = 7;	///< The request id goes after <tt>{"id": </tt>.
+
+	std::string m_request;
+	size_t m_nonceAt = 0;
+	unsigned m_nonceSkip = 0;			///< Nonce digits not sent (the extranonce).
+	size_t m_mixAt = std::string::npos;	///< Not sent by EthereumStratum.
+};
+
+}
+}
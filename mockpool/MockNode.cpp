@@ -0,0 +1,432 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockNode.cpp
+ */
+
+#include "MockNode.h"
+#include <cstdio>
+#include <iomanip>
+#include <libdevcore/Log.h>
+#include "MockPool.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+using boost::asio::local::stream_protocol;
+#endif
+
+namespace
+{
+
+/// @returns the Content-Length of an HTTP request head, 0 if there is none.
+size_t contentLength(string _head)
+{
+	for (auto& c: _head)
+		c = tolower(c);
+	auto p = _head.find("\r\ncontent-length:");
+	return p == string::npos ? 0 : stoul(_head.substr(p + 17));
+}
+
+Json::Value error(Json::Value const& _id, int _code, string const& _message)
+{
+	Json::Value r;
+	r["jsonrpc"] = "2.0";
+	r["id"] = _id;
+	r["error"]["code"] = _code;
+	r["error"]["message"] = _message;
+	return r;
+}
+
+Json::Value result(Json::Value const& _id, Json::Value const& _result)
+{
+	Json::Value r;
+	r["jsonrpc"] = "2.0";
+	r["id"] = _id;
+	r["result"] = _result;
+	return r;
+}
+
+}
+
+struct MockNode::HttpSession
+{
+	HttpSession(boost::asio::io_service& _io): socket(_io) {}
+
+	tcp::socket socket;
+	boost::asio::streambuf buffer;
+	bool closed = false;
+};
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+struct MockNode::IpcSession
+{
+	IpcSession(boost::asio::io_service& _io): socket(_io) {}
+
+	stream_protocol::socket socket;
+	boost::asio::streambuf buffer;
+	deque<string> queue;		///< Being written, front first.
+	bool closed = false;
+};
+#endif
+
+const size_t MockNode::c_blocks;
+
+MockNode::MockNode(MockNodeSettings const& _settings):
+	m_settings(_settings),
+	m_seed(EthashAux::seedHash(_settings.epoch * ETHASH_EPOCH_LENGTH)),
+	m_boundary(difficultyToBoundary(_settings.difficulty)),
+	m_http(m_io),
+	m_blockTimer(m_io),
+	m_random(random_device()()),
+	m_blocks(0),
+	m_getWorks(0),
+	m_accepted(0),
+	m_rejected(0)
+{
+	// Solutions are checked against the light cache; build it before anyone connects.
+	EthashAux::light(m_seed);
+
+	tcp::endpoint endpoint(boost::asio::ip::address::from_string(m_settings.address), m_settings.port);
+	m_http.open(endpoint.protocol());
+	m_http.set_option(tcp::acceptor::reuse_address(true));
+	m_http.bind(endpoint);
+	m_http.listen();
+	cnote << "Mock node listening on http://" + m_settings.address + ":" + to_string(m_settings.port) << "boundary" << m_boundary;
+	acceptHttp();
+
+	if (!m_settings.ipcPath.empty())
+	{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		::remove(m_settings.ipcPath.c_str());
+		m_ipc.reset(new stream_protocol::acceptor(m_io, stream_protocol::endpoint(m_settings.ipcPath)));
+		cnote << "Mock node announcing blocks on" << m_settings.ipcPath;
+		acceptIpc();
+#else
+		cwarn << "IPC sockets are not supported on this platform";
+#endif
+	}
+
+	newBlock();
+	m_delivered = true;
+	m_thread = thread([this]()
+	{
+		dev::setThreadName("node");
+		m_io.run();
+	});
+}
+
+MockNode::~MockNode()
+{
+	m_io.stop();
+	if (m_thread.joinable())
+		m_thread.join();
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	if (m_ipc)
+		::remove(m_settings.ipcPath.c_str());
+#endif
+}
+
+void MockNode::report(ostream& _out) const
+{
+	unsigned shares = m_accepted + m_rejected;
+	_out << "Node: " << m_blocks << " blocks, " << m_getWorks << " eth_getWork calls" << endl;
+	_out << "Solutions: " << m_accepted << " accepted, " << m_rejected << " rejected ("
+		<< fixed << setprecision(1) << (shares ? 100.0 * m_rejected / shares : 0) << "%)" << endl;
+	_out << "New work reached the miner after the block: " << m_delivery << endl;
+}
+
+void MockNode::resetStats()
+{
+	m_getWorks = 0;
+	m_accepted = 0;
+	m_rejected = 0;
+	m_delivery.reset();
+}
+
+void MockNode::newBlock()
+{
+	h256 header;
+	for (unsigned i = 0; i < h256::size; i += 8)
+	{
+		uint64_t r = m_random();
+		memcpy(header.data() + i, &r, 8);
+	}
+	m_headers.push_front(header);
+	if (m_headers.size() > c_blocks)
+		m_headers.pop_back();
+	m_blocks++;
+	m_announced = chrono::steady_clock::now();
+	m_delivered = false;
+
+	// Held long polls get the new work straight away...
+	auto held = move(m_held);
+	m_held.clear();
+	for (auto const& h: held)
+		respond(h.first, result(h.second, work()));
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	// ...and subscribers hear of the block, to fetch it themselves.
+	ostringstream os;
+	os << "{\"jsonrpc\":\"2.0\",\"method\":\"eth_subscription\",\"params\":{\"subscription\":\"0x1\",\"result\":{\"number\":\"0x"
+		<< hex << m_blocks << "\",\"hash\":\"0x" << header.hex() << "\"}}}\n";
+	for (auto const& s: m_subscribers)
+		send(s, os.str());
+#endif
+
+	m_blockTimer.expires_from_now(boost::posix_time::milliseconds(m_settings.blockInterval));
+	m_blockTimer.async_wait([this](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			newBlock();
+	});
+}
+
+Json::Value MockNode::work()
+{
+	if (!m_delivered)
+	{
+		m_delivered = true;
+		m_delivery.record(chrono::steady_clock::now() - m_announced);
+	}
+	Json::Value w(Json::arrayValue);
+	w.append("0x" + m_headers.front().hex());
+	w.append("0x" + m_seed.hex());
+	w.append("0x" + m_boundary.hex());
+	return w;
+}
+
+bool MockNode::submit(string const& _nonce, string const& _header, string const& _mix)
+{
+	uint64_t nonce = 0;
+	h256 header;
+	h256 mix;
+	try
+	{
+		nonce = stoull(_nonce, nullptr, 16);
+		header = h256(_header);
+		mix = h256(_mix);
+	}
+	catch (...)
+	{
+		m_rejected++;
+		return false;
+	}
+	if (find(m_headers.begin(), m_headers.end(), header) == m_headers.end())
+	{
+		cwarn << "Solution for an unknown block";
+		m_rejected++;
+		return false;
+	}
+	Result r = EthashAux::eval(m_seed, header, nonce);
+	if (r.value > m_boundary || r.mixHash != mix)
+	{
+		cwarn << "Invalid solution";
+		m_rejected++;
+		return false;
+	}
+	m_accepted++;
+	return true;
+}
+
+void MockNode::acceptHttp()
+{
+	auto s = make_shared<HttpSession>(m_io);
+	m_http.async_accept(s->socket, [this, s](boost::system::error_code const& _ec)
+	{
+		if (_ec == boost::asio::error::operation_aborted)
+			return;
+		if (!_ec)
+		{
+			boost::system::error_code ec;
+			s->socket.set_option(tcp::no_delay(true), ec);
+			readRequest(s);
+		}
+		acceptHttp();
+	});
+}
+
+void MockNode::readRequest(HttpPtr const& _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\r\n\r\n", [this, _s](boost::system::error_code const& _ec, size_t _n)
+	{
+		if (_ec)
+		{
+			_s->closed = true;
+			return;
+		}
+		string head(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _n);
+		_s->buffer.consume(_n);
+		size_t length = contentLength(head);
+		size_t missing = length > _s->buffer.size() ? length - _s->buffer.size() : 0;
+		boost::asio::async_read(_s->socket, _s->buffer, boost::asio::transfer_exactly(missing), [this, _s, length](boost::system::error_code const& _ec, size_t)
+		{
+			if (_ec)
+			{
+				_s->closed = true;
+				return;
+			}
+			string body(boost::asio::buffer_cast<char const*>(_s->buffer.data()), length);
+			_s->buffer.consume(length);
+			process(_s, body);
+			readRequest(_s);
+		});
+	});
+}
+
+void MockNode::process(HttpPtr const& _s, string const& _body)
+{
+	Json::Value request;
+	if (!Json::Reader().parse(_body, request) || !(request.isObject() || request.isArray()))
+	{
+		respond(_s, error(Json::Value::null, -32700, "Parse error"));
+		return;
+	}
+	if (request.isObject())
+	{
+		Json::Value response = call(_s, request);
+		if (!response.isNull())
+			respond(_s, response);
+		return;
+	}
+	Json::Value responses(Json::arrayValue);
+	for (auto const& r: request)
+	{
+		// A batch is answered at once, so nothing in it is held.
+		if (r.isObject() && r.get("method", "") == "eth_awaitNewWork")
+			responses.append(error(r.get("id", Json::Value::null), -32600, "eth_awaitNewWork can't be batched"));
+		else
+			responses.append(r.isObject() ? call(_s, r) : error(Json::Value::null, -32600, "Invalid request"));
+	}
+	respond(_s, responses);
+}
+
+Json::Value MockNode::call(HttpPtr const& _s, Json::Value const& _request)
+{
+	Json::Value id = _request.get("id", Json::Value::null);
+	Json::Value params = _request.get("params", Json::Value::null);
+	if (!params.isArray())
+		params = Json::Value(Json::arrayValue);
+	auto param = [&](Json::ArrayIndex _i) { return params.get(_i, "").isString() ? params.get(_i, "").asString() : string(); };
+
+	string method = _request.get("method", "").isString() ? _request.get("method", "").asString() : string();
+	if (method == "eth_getWork")
+	{
+		m_getWorks++;
+		return result(id, work());
+	}
+	if (method == "eth_awaitNewWork" && m_settings.awaitNewWork)
+	{
+		m_held.push_back(make_pair(_s, id));
+		return Json::Value::null;
+	}
+	if (method == "eth_submitWork")
+		return result(id, submit(param(0), param(1), param(2)));
+	if (method == "eth_submitHashrate")
+		return result(id, true);
+	return error(id, -32601, "The method " + method + " does not exist");
+}
+
+void MockNode::respond(HttpPtr const& _s, Json::Value const& _response)
+{
+	if (_s->closed)
+		return;
+	string body = Json::FastWriter().write(_response);
+	auto message = make_shared<string>(
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/json\r\n"
+		"Content-Length: " + to_string(body.size()) + "\r\n"
+		"Connection: keep-alive\r\n\r\n" + body);
+	boost::asio::async_write(_s->socket, boost::asio::buffer(*message), [_s, message](boost::system::error_code const& _ec, size_t)
+	{
+		if (_ec)
+			_s->closed = true;
+	});
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+void MockNode::acceptIpc()
+{
+	auto s = make_shared<IpcSession>(m_io);
+	m_ipc->async_accept(s->socket, [this, s](boost::system::error_code const& _ec)
+	{
+		if (_ec == boost::asio::error::operation_aborted)
+			return;
+		if (!_ec)
+			readIpc(s);
+		acceptIpc();
+	});
+}
+
+void MockNode::readIpc(IpcPtr const& _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\n", [this, _s](boost::system::error_code const& _ec, size_t _n)
+	{
+		if (_ec)
+		{
+			_s->closed = true;
+			m_subscribers.erase(_s);
+			return;
+		}
+		string line(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _n);
+		_s->buffer.consume(_n);
+
+		Json::Value request;
+		if (Json::Reader().parse(line, request) && request.isObject())
+		{
+			Json::Value id = request.get("id", Json::Value::null);
+			Json::Value params = request.get("params", Json::Value::null);
+			Json::Value response;
+			if (request.get("method", "") == "eth_subscribe" && params.isArray() && params.get(0u, "") == "newHeads")
+			{
+				m_subscribers.insert(_s);
+				response = result(id, "0x1");
+			}
+			else
+				response = error(id, -32601, "Only eth_subscribe newHeads is served here");
+			send(_s, Json::FastWriter().write(response));
+		}
+		readIpc(_s);
+	});
+}
+
+void MockNode::send(IpcPtr const& _s, string const& _message)
+{
+	if (_s->closed)
+		return;
+	_s->queue.push_back(_message);
+	if (_s->queue.size() == 1)
+		write(_s);
+}
+
+void MockNode::write(IpcPtr const& _s)
+{
+	boost::asio::async_write(_s->socket, boost::asio::buffer(_s->queue.front()), [this, _s](boost::system::error_code const& _ec, size_t)
+	{
+		if (_ec)
+		{
+			_s->closed = true;
+			m_subscribers.erase(_s);
+			return;
+		}
+		_s->queue.pop_front();
+		if (!_s->queue.empty())
+			write(_s);
+	});
+}
+#endif
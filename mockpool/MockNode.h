@@ -0,0 +1,127 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockNode.h
+ * Ethereum node stand-in for testing ethminer's farm mode on loopback.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <json/json.h>
+#include <libdevcore/LatencyHistogram.h>
+#include <libethcore/EthashAux.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct MockNodeSettings
+{
+	std::string address = "127.0.0.1";
+	unsigned short port = 8545;		///< HTTP JSON-RPC.
+	std::string ipcPath;			///< Unix socket taking eth_subscribe; none if empty.
+	unsigned blockInterval = 5000;	///< ms between blocks.
+	double difficulty = 0.01;
+	unsigned epoch = 0;
+	bool awaitNewWork = true;		///< Hold eth_awaitNewWork until the next block; refuse it otherwise.
+};
+
+/**
+ * @brief A node that hands out work over HTTP JSON-RPC (eth_getWork,
+ * eth_submitWork, eth_submitHashrate, batches, and eth_awaitNewWork held until
+ * the next block), and announces each block to newHeads subscribers on a Unix
+ * socket, as geth does on its IPC socket. It measures how long after a block
+ * its work reaches the miner, by whichever of the three ways comes first.
+ * @threadsafe
+ */
+class MockNode
+{
+public:
+	explicit MockNode(MockNodeSettings const& _settings);
+	~MockNode();
+
+	void report(std::ostream& _out) const;
+	/// Forgets the shares and latencies measured so far.
+	void resetStats();
+
+private:
+	struct HttpSession;
+	struct IpcSession;
+	typedef std::shared_ptr<HttpSession> HttpPtr;
+	typedef std::shared_ptr<IpcSession> IpcPtr;
+
+	/// Headers a submitted solution is still checked against.
+	static const size_t c_blocks = 8;
+
+	void acceptHttp();
+	void readRequest(HttpPtr const& _s);
+	void process(HttpPtr const& _s, std::string const& _body);
+	/// @returns the response to one call, or a null value if it is held until the next block.
+	Json::Value call(HttpPtr const& _s, Json::Value const& _request);
+	void respond(HttpPtr const& _s, Json::Value const& _response);
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	void acceptIpc();
+	void readIpc(IpcPtr const& _s);
+	void send(IpcPtr const& _s, std::string const& _message);
+	void write(IpcPtr const& _s);
+#endif
+
+	void newBlock();
+	Json::Value work();
+	bool submit(std::string const& _nonce, std::string const& _header, std::string const& _mix);
+
+	MockNodeSettings m_settings;
+	h256 m_seed;
+	h256 m_boundary;
+
+	boost::asio::io_service m_io;
+	boost::asio::ip::tcp::acceptor m_http;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	std::unique_ptr<boost::asio::local::stream_protocol::acceptor> m_ipc;
+#endif
+	boost::asio::deadline_timer m_blockTimer;
+	std::mt19937_64 m_random;
+
+	// Only touched on m_io's thread.
+	std::deque<h256> m_headers;					///< Newest first.
+	std::chrono::steady_clock::time_point m_announced;
+	bool m_delivered = true;					///< The newest block's work has reached the miner.
+	std::vector<std::pair<HttpPtr, Json::Value>> m_held;	///< eth_awaitNewWork calls and their ids.
+	std::set<IpcPtr> m_subscribers;				///< Empty where there are no IPC sockets.
+
+	std::atomic<unsigned> m_blocks;
+	std::atomic<unsigned> m_getWorks;
+	std::atomic<unsigned> m_accepted;
+	std::atomic<unsigned> m_rejected;
+	LatencyHistogram m_delivery;				///< From a block to its work reaching the miner.
+	std::thread m_thread;
+};
+
+}
+}
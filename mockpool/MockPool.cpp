@@ -0,0 +1,433 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockPool.cpp
+ */
+
+#include "MockPool.h"
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <json/json.h>
+#include <libdevcore/Log.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+
+namespace
+{
+
+string hex(uint64_t _value, unsigned _digits)
+{
+	char buf[17];
+	snprintf(buf, sizeof(buf), "%0*llx", int(_digits), (unsigned long long)_value);
+	return string(buf, _digits);
+}
+
+/// Strips an optional 0x and checks for 16 hex digits.
+bool parseNonce(string _hex, uint64_t& o_nonce)
+{
+	if (_hex.compare(0, 2, "0x") == 0)
+		_hex = _hex.substr(2);
+	if (_hex.size() != 16 || _hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+		return false;
+	o_nonce = stoull(_hex, nullptr, 16);
+	return true;
+}
+
+}
+
+struct MockPool::Session
+{
+	Session(boost::asio::io_service& _io): socket(_io) {}
+
+	tcp::socket socket;
+	boost::asio::streambuf buffer;
+	deque<string> queue;		///< Being written, front first.
+	string extranonce;			///< EthereumStratum only.
+	string worker;
+	bool authorized = false;
+	bool closed = false;
+};
+
+const size_t MockPool::c_jobs;
+
+h256 dev::eth::difficultyToBoundary(double _difficulty)
+{
+	// 0xffff0000 * 2^192 / difficulty, like the clients' diffToTarget().
+	double target = ldexp(4294901760.0, 192) / _difficulty;
+	h256 ret;
+	for (unsigned i = 0; i < h256::size; ++i)
+	{
+		if (!(target < ldexp(1.0, 256)))
+		{
+			ret[i] = 0xff;
+			continue;
+		}
+		double scale = ldexp(1.0, 8 * (31 - i));
+		unsigned b = min(unsigned(floor(target / scale)), 255u);
+		ret[i] = uint8_t(b);
+		target -= b * scale;
+	}
+	return ret;
+}
+
+MockPool::MockPool(MockPoolSettings const& _settings):
+	m_settings(_settings),
+	m_seed(EthashAux::seedHash(_settings.epoch * ETHASH_EPOCH_LENGTH)),
+	m_boundary(difficultyToBoundary(_settings.difficulty)),
+	m_acceptor(m_io),
+	m_jobTimer(m_io),
+	m_extranonceTimer(m_io),
+	m_disconnectTimer(m_io),
+	m_random(random_device()()),
+	m_nextJob(0),
+	m_connections(0),
+	m_accepted(0),
+	m_stale(0),
+	m_rejected(0)
+{
+	// Shares are checked against the light cache; build it before anyone connects.
+	EthashAux::light(m_seed);
+
+	tcp::endpoint endpoint(boost::asio::ip::address::from_string(m_settings.address), m_settings.port);
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen();
+	cnote << "Mock pool listening on" << m_settings.address + ":" + to_string(m_settings.port) << "protocol" << m_settings.protocol << "boundary" << m_boundary;
+
+	accept();
+	newJob();
+	if (m_settings.extranonceInterval && m_settings.protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM)
+		schedule(m_extranonceTimer, m_settings.extranonceInterval * 1000, &MockPool::changeExtranonces);
+	if (m_settings.disconnectInterval)
+		schedule(m_disconnectTimer, m_settings.disconnectInterval * 1000, &MockPool::dropAll);
+	m_thread = thread([this]()
+	{
+		dev::setThreadName("pool");
+		m_io.run();
+	});
+}
+
+MockPool::~MockPool()
+{
+	m_io.stop();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool MockPool::sentAt(h256 const& _header, chrono::steady_clock::time_point& o_sent) const
+{
+	Guard l(x_jobs);
+	for (auto const& job: m_jobs)
+		if (job.header == _header)
+		{
+			o_sent = job.sent;
+			return true;
+		}
+	return false;
+}
+
+void MockPool::report(ostream& _out) const
+{
+	unsigned shares = m_accepted + m_rejected;
+	_out << "Pool: " << m_nextJob << " jobs, " << m_connections << " connections" << endl;
+	_out << "Shares: " << m_accepted << " accepted, " << m_stale << " of them stale ("
+		<< fixed << setprecision(1) << (m_accepted ? 100.0 * m_stale / m_accepted : 0) << "%), "
+		<< m_rejected << " rejected (" << (shares ? 100.0 * m_rejected / shares : 0) << "%)" << endl;
+	_out << "Stale shares after the job switch: " << m_staleLag << endl;
+}
+
+void MockPool::resetStats()
+{
+	m_accepted = 0;
+	m_stale = 0;
+	m_rejected = 0;
+	m_staleLag.reset();
+}
+
+void MockPool::schedule(boost::asio::deadline_timer& _timer, unsigned _ms, void (MockPool::*_tick)())
+{
+	_timer.expires_from_now(boost::posix_time::milliseconds(_ms));
+	_timer.async_wait([this, _tick](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			(this->*_tick)();
+	});
+}
+
+void MockPool::accept()
+{
+	auto s = make_shared<Session>(m_io);
+	m_acceptor.async_accept(s->socket, [this, s](boost::system::error_code const& _ec)
+	{
+		if (_ec == boost::asio::error::operation_aborted)
+			return;
+		if (!_ec)
+		{
+			boost::system::error_code ec;
+			s->socket.set_option(tcp::no_delay(true), ec);
+			s->extranonce = hex(m_random(), 4);
+			m_sessions.insert(s);
+			m_connections++;
+			cnote << "Client connected from" << s->socket.remote_endpoint(ec);
+			read(s);
+		}
+		accept();
+	});
+}
+
+void MockPool::newJob()
+{
+	Job job;
+	job.id = hex(++m_nextJob, 8);
+	for (unsigned i = 0; i < h256::size; i += 8)
+	{
+		uint64_t r = m_random();
+		memcpy(job.header.data() + i, &r, 8);
+	}
+	job.sent = chrono::steady_clock::now();
+	{
+		Guard l(x_jobs);
+		if (!m_jobs.empty())
+			m_jobs.front().superseded = job.sent;
+		m_jobs.push_front(move(job));
+		if (m_jobs.size() > c_jobs)
+			m_jobs.pop_back();
+	}
+	for (auto const& s: m_sessions)
+		if (s->authorized)
+			send(s, notification());
+	schedule(m_jobTimer, m_settings.jobInterval, &MockPool::newJob);
+}
+
+void MockPool::changeExtranonces()
+{
+	for (auto const& s: m_sessions)
+	{
+		s->extranonce = hex(m_random(), 4);
+		send(s, "{\"id\": null, \"method\": \"mining.set_extranonce\", \"params\": [\"" + s->extranonce + "\"]}\n");
+	}
+	schedule(m_extranonceTimer, m_settings.extranonceInterval * 1000, &MockPool::changeExtranonces);
+}
+
+void MockPool::dropAll()
+{
+	cnote << "Dropping" << m_sessions.size() << "connections";
+	auto sessions = m_sessions;
+	for (auto const& s: sessions)
+		close(s);
+	schedule(m_disconnectTimer, m_settings.disconnectInterval * 1000, &MockPool::dropAll);
+}
+
+string MockPool::notification() const
+{
+	Guard l(x_jobs);
+	Job const& job = m_jobs.front();
+	switch (m_settings.protocol)
+	{
+	case STRATUM_PROTOCOL_ETHPROXY:
+		return "{\"id\": 0, \"jsonrpc\": \"2.0\", \"result\": [\"0x" + job.header.hex() + "\",\"0x" + m_seed.hex() + "\",\"0x" + m_boundary.hex() + "\"]}\n";
+	case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
+		return "{\"id\": null, \"method\": \"mining.notify\", \"params\": [\"" + job.id + "\",\"" + m_seed.hex() + "\",\"" + job.header.hex() + "\",true]}\n";
+	default:
+		return "{\"id\": null, \"method\": \"mining.notify\", \"params\": [\"" + job.id + "\",\"0x" + job.header.hex() + "\",\"0x" + m_seed.hex() + "\",\"0x" + m_boundary.hex() + "\",true]}\n";
+	}
+}
+
+void MockPool::read(SessionPtr const& _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\n", [this, _s](boost::system::error_code const& _ec, size_t _n)
+	{
+		if (_ec)
+		{
+			close(_s);
+			return;
+		}
+		string line(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _n);
+		_s->buffer.consume(_n);
+		process(_s, line);
+		if (!_s->closed)
+			read(_s);
+	});
+}
+
+void MockPool::process(SessionPtr const& _s, string const& _line)
+{
+	Json::Value request;
+	if (!Json::Reader().parse(_line, request) || !request.isObject())
+	{
+		cwarn << "Malformed request:" << _line;
+		close(_s);
+		return;
+	}
+	string id = Json::FastWriter().write(request.get("id", Json::Value::null));
+	id.erase(id.find_last_not_of("\n") + 1);
+	string method = request.get("method", "").asString();
+	Json::Value params = request.get("params", Json::Value::null);
+	if (!params.isArray())
+		params = Json::Value(Json::arrayValue);
+	auto param = [&](Json::ArrayIndex _i) { return params.get(_i, "").asString(); };
+	auto result = [&](string const& _result) { respond(_s, "{\"id\": " + id + ", \"result\": " + _result + ", \"error\": null}\n"); };
+
+	bool protocolES = m_settings.protocol == STRATUM_PROTOCOL_ETHEREUMSTRATUM;
+	if (method == "mining.subscribe")
+		result(protocolES ? "[[\"mining.notify\",\"" + _s->extranonce + "\",\"EthereumStratum/1.0.0\"],\"" + _s->extranonce + "\"]" : "true");
+	else if (method == "mining.authorize" || method == "eth_submitLogin")
+	{
+		_s->worker = param(0);
+		_s->authorized = true;
+		result("true");
+		if (protocolES)
+		{
+			ostringstream os;
+			os << "{\"id\": null, \"method\": \"mining.set_difficulty\", \"params\": [" << setprecision(17) << m_settings.difficulty << "]}\n";
+			respond(_s, os.str());
+		}
+		if (m_settings.protocol != STRATUM_PROTOCOL_ETHPROXY)
+			respond(_s, notification());
+	}
+	else if (method == "eth_getWork")
+	{
+		string job = notification();
+		respond(_s, "{\"id\": " + id + job.substr(job.find(',')));
+	}
+	else if (method == "mining.submit" || method == "eth_submitWork")
+	{
+		string error;
+		if (!_s->authorized)
+			error = "Unauthorized worker";
+		else if (method == "eth_submitWork")
+			error = share("", param(1), param(0), param(2));
+		else if (protocolES)
+			error = share(param(1), "", _s->extranonce + param(2), "");
+		else
+			error = share(param(1), param(3), param(2), param(4));
+		if (error.empty())
+			result("true");
+		else
+		{
+			cwarn << "Share from" << _s->worker << "rejected:" << error;
+			respond(_s, "{\"id\": " + id + ", \"result\": false, \"error\": [23, \"" + error + "\", null]}\n");
+		}
+	}
+	else if (method == "mining.extranonce.subscribe" || method == "eth_submitHashrate")
+		result("true");
+	else
+		respond(_s, "{\"id\": " + id + ", \"result\": null, \"error\": [20, \"Method not found\", null]}\n");
+}
+
+string MockPool::share(string const& _job, string const& _header, string const& _nonce, string const& _mix)
+{
+	uint64_t nonce;
+	if (!parseNonce(_nonce, nonce))
+	{
+		m_rejected++;
+		return "Malformed nonce";
+	}
+
+	h256 header;
+	bool stale = false;
+	chrono::steady_clock::time_point superseded;
+	{
+		Guard l(x_jobs);
+		auto job = m_jobs.begin();
+		for (; job != m_jobs.end(); ++job)
+			if (_job.empty() ? job->header == h256(_header) : job->id == _job)
+				break;
+		if (job == m_jobs.end())
+		{
+			m_rejected++;
+			return "Job not found";
+		}
+		if (!job->nonces.insert(nonce).second)
+		{
+			m_rejected++;
+			return "Duplicate share";
+		}
+		header = job->header;
+		stale = job != m_jobs.begin();
+		superseded = job->superseded;
+	}
+
+	Result r = EthashAux::eval(m_seed, header, nonce);
+	if (r.value > m_boundary)
+	{
+		m_rejected++;
+		return "Low difficulty share";
+	}
+	if (!_mix.empty() && h256(_mix) != r.mixHash)
+	{
+		m_rejected++;
+		return "Invalid mix hash";
+	}
+	if (stale)
+	{
+		m_stale++;
+		m_staleLag.record(chrono::steady_clock::now() - superseded);
+	}
+	m_accepted++;
+	return "";
+}
+
+void MockPool::respond(SessionPtr const& _s, string const& _message)
+{
+	if (!m_settings.delay)
+	{
+		send(_s, _message);
+		return;
+	}
+	auto timer = make_shared<boost::asio::deadline_timer>(m_io, boost::posix_time::milliseconds(m_settings.delay));
+	timer->async_wait([this, _s, _message, timer](boost::system::error_code const&) { send(_s, _message); });
+}
+
+void MockPool::send(SessionPtr const& _s, string const& _message)
+{
+	if (_s->closed)
+		return;
+	_s->queue.push_back(_message);
+	if (_s->queue.size() == 1)
+		write(_s);
+}
+
+void MockPool::write(SessionPtr const& _s)
+{
+	boost::asio::async_write(_s->socket, boost::asio::buffer(_s->queue.front()), [this, _s](boost::system::error_code const& _ec, size_t)
+	{
+		if (_ec || _s->closed)
+		{
+			close(_s);
+			return;
+		}
+		_s->queue.pop_front();
+		if (!_s->queue.empty())
+			write(_s);
+	});
+}
+
+void MockPool::close(SessionPtr const& _s)
+{
+	if (_s->closed)
+		return;
+	_s->closed = true;
+	boost::system::error_code ec;
+	_s->socket.close(ec);
+	m_sessions.erase(_s);
+}
@@ -0,0 +1,135 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockPool.h
+ * Stratum pool stand-in for testing the clients on loopback.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <libdevcore/Guards.h>
+#include <libdevcore/LatencyHistogram.h>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Miner.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct MockPoolSettings
+{
+	int protocol = STRATUM_PROTOCOL_STRATUM;
+	std::string address = "127.0.0.1";
+	unsigned short port = 3333;
+	unsigned jobInterval = 5000;		///< ms between jobs.
+	double difficulty = 0.01;
+	unsigned extranonceInterval = 0;	///< s between extranonce changes (EthereumStratum), 0 for never.
+	unsigned disconnectInterval = 0;	///< s between dropping every connection, 0 for never.
+	unsigned delay = 0;					///< ms before each response.
+	unsigned epoch = 0;
+};
+
+/// The share target of @a _difficulty, as the stratum clients compute it.
+h256 difficultyToBoundary(double _difficulty);
+
+/**
+ * @brief A pool that speaks all three stratum dialects, sends a new job every
+ * jobInterval and checks each share with EthashAux. Disconnects, extranonce
+ * changes and slow responses can be injected to see how a client copes.
+ * @threadsafe
+ */
+class MockPool
+{
+public:
+	explicit MockPool(MockPoolSettings const& _settings);
+	~MockPool();
+
+	/// When the job with @a _header was sent; false if it is unknown.
+	bool sentAt(h256 const& _header, std::chrono::steady_clock::time_point& o_sent) const;
+
+	void report(std::ostream& _out) const;
+	/// Forgets the shares and latencies measured so far.
+	void resetStats();
+
+private:
+	struct Session;
+	typedef std::shared_ptr<Session> SessionPtr;
+
+	struct Job
+	{
+		std::string id;
+		h256 header;
+		std::chrono::steady_clock::time_point sent;
+		std::chrono::steady_clock::time_point superseded;	///< When the next job was sent.
+		std::set<uint64_t> nonces;
+	};
+
+	/// Jobs a share is still checked against; older ones are rejected.
+	static const size_t c_jobs = 8;
+
+	void accept();
+	void newJob();
+	void changeExtranonces();
+	void dropAll();
+	void schedule(boost::asio::deadline_timer& _timer, unsigned _ms, void (MockPool::*_tick)());
+	void read(SessionPtr const& _s);
+	void process(SessionPtr const& _s, std::string const& _line);
+	/// @returns the error message, empty if the share is accepted.
+	std::string share(std::string const& _job, std::string const& _header, std::string const& _nonce, std::string const& _mix);
+	std::string notification() const;
+	void respond(SessionPtr const& _s, std::string const& _message);
+	void send(SessionPtr const& _s, std::string const& _message);
+	void write(SessionPtr const& _s);
+	void close(SessionPtr const& _s);
+
+	MockPoolSettings m_settings;
+	h256 m_seed;
+	h256 m_boundary;
+
+	boost::asio::io_service m_io;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	boost::asio::deadline_timer m_jobTimer;
+	boost::asio::deadline_timer m_extranonceTimer;
+	boost::asio::deadline_timer m_disconnectTimer;
+	std::set<SessionPtr> m_sessions;			///< Only touched on m_io's thread.
+	std::mt19937_64 m_random;
+
+	mutable Mutex x_jobs;
+	std::deque<Job> m_jobs;					///< Newest first.
+
+	std::atomic<unsigned> m_nextJob;
+	std::atomic<unsigned> m_connections;
+	std::atomic<unsigned> m_accepted;
+	std::atomic<unsigned> m_stale;			///< Accepted, but for a superseded job.
+	std::atomic<unsigned> m_rejected;
+	LatencyHistogram m_staleLag;			///< From the job switch to a stale share's arrival.
+	std::thread m_thread;
+};
+
+}
+}
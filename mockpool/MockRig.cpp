@@ -0,0 +1,256 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockRig.cpp
+ */
+
+#include "MockRig.h"
+#include <cstdio>
+#include <deque>
+#include <json/json.h>
+#include <libdevcore/Log.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+
+struct MockRig::Rig
+{
+	Rig(boost::asio::io_service& _io, unsigned _index): socket(_io), timer(_io), name("rig" + to_string(_index)) {}
+
+	tcp::socket socket;
+	boost::asio::deadline_timer timer;	///< Reconnects, or paces the shares.
+	boost::asio::streambuf buffer;
+	deque<string> queue;				///< Being written, front first.
+	string name;
+	string extranonce;
+	h256 boundary;
+	string job;
+	h256 seed;
+	h256 header;
+	unsigned nextId = 10;
+	unsigned session = 0;				///< Counts connections, so late completions of a closed one are ignored.
+	map<unsigned, chrono::steady_clock::time_point> submits;
+	bool connected = false;
+};
+
+const unsigned MockRig::c_maxTries;
+
+MockRig::MockRig(MockPool const& _pool, string const& _host, unsigned short _port, unsigned _rigs, double _sharesPerSecond):
+	m_pool(_pool),
+	m_endpoint(boost::asio::ip::address::from_string(_host), _port),
+	m_shareInterval(_sharesPerSecond > 0 ? unsigned(1000 / _sharesPerSecond) : 0),
+	m_random(random_device()()),
+	m_submitted(0),
+	m_accepted(0),
+	m_rejected(0)
+{
+	for (unsigned i = 0; i < _rigs; ++i)
+	{
+		m_rigs.push_back(make_shared<Rig>(m_io, i));
+		connect(m_rigs.back());
+	}
+	m_thread = thread([this]()
+	{
+		dev::setThreadName("rigs");
+		m_io.run();
+	});
+}
+
+MockRig::~MockRig()
+{
+	m_io.stop();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void MockRig::report(ostream& _out) const
+{
+	_out << "Rigs: " << m_submitted << " shares submitted, " << m_accepted << " accepted, " << m_rejected << " rejected" << endl;
+	_out << "Job switch (pool to rig): " << m_jobSwitch << endl;
+	_out << "Share round trip (rig to proxy): " << m_shareRoundTrip << endl;
+}
+
+void MockRig::resetStats()
+{
+	m_submitted = 0;
+	m_accepted = 0;
+	m_rejected = 0;
+	m_jobSwitch.reset();
+	m_shareRoundTrip.reset();
+}
+
+void MockRig::connect(RigPtr const& _r)
+{
+	_r->socket.async_connect(m_endpoint, [this, _r](boost::system::error_code const& _ec)
+	{
+		if (_ec)
+		{
+			reconnect(_r);
+			return;
+		}
+		boost::system::error_code ec;
+		_r->socket.set_option(tcp::no_delay(true), ec);
+		_r->connected = true;
+		send(_r, "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": [\"mockrig\",\"EthereumStratum/1.0.0\"]}\n");
+		send(_r, "{\"id\": 2, \"method\": \"mining.authorize\", \"params\": [\"" + _r->name + "\",\"x\"]}\n");
+		read(_r);
+	});
+}
+
+void MockRig::reconnect(RigPtr const& _r)
+{
+	boost::system::error_code ec;
+	_r->socket.close(ec);
+	_r->connected = false;
+	_r->session++;
+	_r->queue.clear();
+	_r->buffer.consume(_r->buffer.size());
+	_r->submits.clear();
+	_r->job.clear();
+	_r->timer.cancel(ec);
+	_r->timer.expires_from_now(boost::posix_time::seconds(1));
+	_r->timer.async_wait([this, _r](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			connect(_r);
+	});
+}
+
+void MockRig::read(RigPtr const& _r)
+{
+	unsigned session = _r->session;
+	boost::asio::async_read_until(_r->socket, _r->buffer, "\n", [this, _r, session](boost::system::error_code const& _ec, size_t _n)
+	{
+		if (session != _r->session)
+			return;
+		if (_ec)
+		{
+			reconnect(_r);
+			return;
+		}
+		string line(boost::asio::buffer_cast<char const*>(_r->buffer.data()), _n);
+		_r->buffer.consume(_n);
+		process(_r, line);
+		read(_r);
+	});
+}
+
+void MockRig::process(RigPtr const& _r, string const& _line)
+{
+	auto now = chrono::steady_clock::now();
+	Json::Value msg;
+	if (!Json::Reader().parse(_line, msg) || !msg.isObject())
+		return;
+	string method = msg.get("method", "").asString();
+	Json::Value params = msg.get("params", Json::Value::null);
+
+	if (method == "mining.notify" && params.isArray() && params.size() >= 3)
+	{
+		// The job a rig gets on login was not sent to it by the pool just now.
+		h256 header(params[2].asString());
+		bool first = _r->job.empty();
+		chrono::steady_clock::time_point sent;
+		if (!first && m_pool.sentAt(header, sent))
+			m_jobSwitch.record(now - sent);
+		_r->job = params[0].asString();
+		_r->seed = h256(params[1].asString());
+		_r->header = header;
+		if (first && m_shareInterval)
+			mine(_r);
+	}
+	else if (method == "mining.set_difficulty" && params.isArray() && params.size() >= 1)
+		_r->boundary = difficultyToBoundary(params[0].asDouble());
+	else if (method == "mining.set_extranonce" && params.isArray() && params.size() >= 1)
+		_r->extranonce = params[0].asString();
+	else if (method.empty())
+	{
+		unsigned id = msg.get("id", 0).isIntegral() ? msg.get("id", 0).asUInt() : 0;
+		if (id == 1)
+		{
+			Json::Value result = msg.get("result", Json::Value::null);
+			if (result.isArray() && result.size() >= 2)
+				_r->extranonce = result[1].asString();
+			return;
+		}
+		auto it = _r->submits.find(id);
+		if (it == _r->submits.end())
+			return;
+		m_shareRoundTrip.record(now - it->second);
+		_r->submits.erase(it);
+		if (msg.get("result", false).asBool())
+			m_accepted++;
+		else
+			m_rejected++;
+	}
+}
+
+void MockRig::mine(RigPtr const& _r)
+{
+	if (!_r->connected)
+		return;
+	unsigned digits = 16 - min<unsigned>(_r->extranonce.size(), 16);
+	if (!_r->job.empty() && digits)
+	{
+		uint64_t mask = digits == 16 ? ~uint64_t(0) : (uint64_t(1) << (4 * digits)) - 1;
+		uint64_t prefix = _r->extranonce.empty() ? 0 : stoull(_r->extranonce, nullptr, 16) << (4 * digits);
+		for (unsigned i = 0; i < c_maxTries; ++i)
+		{
+			uint64_t suffix = m_random() & mask;
+			if (EthashAux::eval(_r->seed, _r->header, prefix | suffix).value > _r->boundary)
+				continue;
+			char nonce[17];
+			snprintf(nonce, sizeof(nonce), "%0*llx", int(digits), (unsigned long long)suffix);
+			unsigned id = _r->nextId++;
+			_r->submits[id] = chrono::steady_clock::now();
+			m_submitted++;
+			send(_r, "{\"id\": " + to_string(id) + ", \"method\": \"mining.submit\", \"params\": [\"" + _r->name + "\",\"" + _r->job + "\",\"" + nonce + "\"]}\n");
+			break;
+		}
+	}
+	_r->timer.expires_from_now(boost::posix_time::milliseconds(m_shareInterval));
+	_r->timer.async_wait([this, _r](boost::system::error_code const& _ec)
+	{
+		if (!_ec)
+			mine(_r);
+	});
+}
+
+void MockRig::send(RigPtr const& _r, string const& _message)
+{
+	_r->queue.push_back(_message);
+	if (_r->queue.size() == 1)
+		write(_r);
+}
+
+void MockRig::write(RigPtr const& _r)
+{
+	unsigned session = _r->session;
+	boost::asio::async_write(_r->socket, boost::asio::buffer(_r->queue.front()), [this, _r, session](boost::system::error_code const& _ec, size_t)
+	{
+		if (session != _r->session)
+			return;
+		if (_ec)
+		{
+			reconnect(_r);
+			return;
+		}
+		_r->queue.pop_front();
+		if (!_r->queue.empty())
+			write(_r);
+	});
+}
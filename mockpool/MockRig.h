@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MockRig.h
+ * CPU stand-ins for mining rigs, to drive ethminer's proxy mode without a GPU.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <libdevcore/LatencyHistogram.h>
+#include <libethcore/EthashAux.h>
+#include "MockPool.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Miners that speak EthereumStratum/1.0.0 to `ethminer --proxy` and find
+ * shares with EthashAux on the CPU, so only an easy share target is practical.
+ * As they run in the same process as the MockPool, they can time a job from
+ * the moment the pool sends it to the moment it reaches a rig.
+ * @threadsafe
+ */
+class MockRig
+{
+public:
+	MockRig(MockPool const& _pool, std::string const& _host, unsigned short _port, unsigned _rigs, double _sharesPerSecond);
+	~MockRig();
+
+	void report(std::ostream& _out) const;
+	void resetStats();
+
+private:
+	struct Rig;
+	typedef std::shared_ptr<Rig> RigPtr;
+
+	/// Nonces tried per share before the rig gives up until its next turn.
+	static const unsigned c_maxTries = 64;
+
+	void connect(RigPtr const& _r);
+	void reconnect(RigPtr const& _r);
+	void read(RigPtr const& _r);
+	void process(RigPtr const& _r, std::string const& _line);
+	void mine(RigPtr const& _r);
+	void send(RigPtr const& _r, std::string const& _message);
+	void write(RigPtr const& _r);
+
+	MockPool const& m_pool;
+	boost::asio::ip::tcp::endpoint m_endpoint;
+	unsigned m_shareInterval;			///< ms between a rig's shares.
+
+	boost::asio::io_service m_io;
+	std::vector<RigPtr> m_rigs;			///< Only touched on m_io's thread.
+	std::mt19937_64 m_random;
+
+	std::atomic<unsigned> m_submitted;
+	std::atomic<unsigned> m_accepted;
+	std::atomic<unsigned> m_rejected;
+	LatencyHistogram m_jobSwitch;		///< From the pool sending a job to a rig receiving it.
+	LatencyHistogram m_shareRoundTrip;	///< From a rig's submit to the proxy's response.
+	std::thread m_thread;
+};
+
+}
+}
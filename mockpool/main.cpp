@@ -0,0 +1,190 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file main.cpp
+ * Mock stratum pool and node for testing ethminer on loopback; see
+ * scripts/pool-test.sh and scripts/node-test.sh.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <signal.h>
+#include "MockNode.h"
+#include "MockPool.h"
+#include "MockRig.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+atomic<bool> g_interrupted(false);
+
+void onSignal(int)
+{
+	g_interrupted = true;
+}
+
+void help()
+{
+	cout
+		<< "Usage mockpool [OPTIONS]" << endl
+		<< "Options:" << endl << endl
+		<< "    -p, --port <n>  Port to listen on (default: 3333)" << endl
+		<< "    --node <n>  Be a node serving farm mode's JSON-RPC over HTTP on port n instead of a pool; --job-interval is the block time" << endl
+		<< "    --ipc <path>  Announce each block to eth_subscribe newHeads on this Unix socket; --node only" << endl
+		<< "    --no-await  Refuse eth_awaitNewWork instead of holding it until the next block; --node only" << endl
+		<< "    -SP, --stratum-protocol <n>  0: stratum, 1: eth-proxy, 2: EthereumStratum/1.0.0 (default: 0)" << endl
+		<< "    --job-interval <ms>  Time between jobs (default: 5000)" << endl
+		<< "    --difficulty <d>  Share difficulty (default: 0.01)" << endl
+		<< "    --extranonce-interval <s>  Change every client's extranonce this often; EthereumStratum only (default: never)" << endl
+		<< "    --disconnect-interval <s>  Drop every connection this often (default: never)" << endl
+		<< "    --delay <ms>  Delay each response by this much (default: 0)" << endl
+		<< "    --epoch <n>  Ethash epoch of the jobs (default: 0)" << endl
+		<< "    --rigs <n> <port>  Run n CPU miners against an ethminer --proxy listening on port" << endl
+		<< "    --share-rate <n>  Shares per second each rig tries to find (default: 1)" << endl
+		<< "    --warmup <s>  Only count what happens after this long, once the clients have logged in and built their caches (default: 5)" << endl
+		<< "    --duration <s>  Print the report and exit after this long (default: run until interrupted)" << endl
+		<< "    -h, --help  Show this help message and exit" << endl;
+	exit(0);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	MockPoolSettings settings;
+	MockNodeSettings nodeSettings;
+	bool node = false;
+	unsigned rigs = 0;
+	unsigned short rigPort = 0;
+	double shareRate = 1;
+	unsigned warmup = 5;
+	unsigned duration = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		try
+		{
+			if ((arg == "-p" || arg == "--port") && i + 1 < argc)
+				settings.port = stoul(argv[++i]);
+			else if (arg == "--node" && i + 1 < argc)
+			{
+				node = true;
+				nodeSettings.port = stoul(argv[++i]);
+			}
+			else if (arg == "--ipc" && i + 1 < argc)
+				nodeSettings.ipcPath = argv[++i];
+			else if (arg == "--no-await")
+				nodeSettings.awaitNewWork = false;
+			else if ((arg == "-SP" || arg == "--stratum-protocol") && i + 1 < argc)
+				settings.protocol = stoi(argv[++i]);
+			else if (arg == "--job-interval" && i + 1 < argc)
+				settings.jobInterval = stoul(argv[++i]);
+			else if (arg == "--difficulty" && i + 1 < argc)
+				settings.difficulty = stod(argv[++i]);
+			else if (arg == "--extranonce-interval" && i + 1 < argc)
+				settings.extranonceInterval = stoul(argv[++i]);
+			else if (arg == "--disconnect-interval" && i + 1 < argc)
+				settings.disconnectInterval = stoul(argv[++i]);
+			else if (arg == "--delay" && i + 1 < argc)
+				settings.delay = stoul(argv[++i]);
+			else if (arg == "--epoch" && i + 1 < argc)
+				settings.epoch = stoul(argv[++i]);
+			else if (arg == "--rigs" && i + 2 < argc)
+			{
+				rigs = stoul(argv[++i]);
+				rigPort = stoul(argv[++i]);
+			}
+			else if (arg == "--share-rate" && i + 1 < argc)
+				shareRate = stod(argv[++i]);
+			else if (arg == "--warmup" && i + 1 < argc)
+				warmup = stoul(argv[++i]);
+			else if (arg == "--duration" && i + 1 < argc)
+				duration = stoul(argv[++i]);
+			else if (arg == "-h" || arg == "--help")
+				help();
+			else
+			{
+				cerr << "Invalid argument: " << arg << endl;
+				exit(-1);
+			}
+		}
+		catch (...)
+		{
+			cerr << "Bad " << arg << " option: " << argv[i] << endl;
+			exit(-1);
+		}
+	}
+	if (settings.protocol < STRATUM_PROTOCOL_STRATUM || settings.protocol > STRATUM_PROTOCOL_ETHEREUMSTRATUM || settings.difficulty <= 0 || !settings.jobInterval)
+	{
+		cerr << "Bad protocol, difficulty or job interval" << endl;
+		exit(-1);
+	}
+
+	signal(SIGINT, &onSignal);
+	signal(SIGTERM, &onSignal);
+
+	unique_ptr<MockPool> pool;
+	unique_ptr<MockNode> mockNode;
+	unique_ptr<MockRig> rig;
+	if (node)
+	{
+		nodeSettings.blockInterval = settings.jobInterval;
+		nodeSettings.difficulty = settings.difficulty;
+		nodeSettings.epoch = settings.epoch;
+		mockNode.reset(new MockNode(nodeSettings));
+	}
+	else
+	{
+		pool.reset(new MockPool(settings));
+		if (rigs)
+			rig.reset(new MockRig(*pool, "127.0.0.1", rigPort, rigs, shareRate));
+	}
+
+	auto start = chrono::steady_clock::now();
+	auto warm = start + chrono::seconds(warmup);
+	auto end = start + chrono::seconds(duration);
+	bool warming = warmup > 0;
+	while (!g_interrupted && (!duration || chrono::steady_clock::now() < end))
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+		if (warming && chrono::steady_clock::now() >= warm)
+		{
+			warming = false;
+			if (pool)
+				pool->resetStats();
+			if (mockNode)
+				mockNode->resetStats();
+			if (rig)
+				rig->resetStats();
+		}
+	}
+
+	if (pool)
+		pool->report(cout);
+	if (mockNode)
+		mockNode->report(cout);
+	if (rig)
+		rig->report(cout);
+	return 0;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env sh
+
+# This script runs ethminer in farm mode against the mock node on loopback and
+# prints how long after each block its work reached ethminer.
+#
+# --mode picks how ethminer learns of new blocks: notify subscribes on the
+# node's IPC socket (--farm-notify), longpoll holds eth_awaitNewWork, poll
+# checks eth_getWork every --farm-recheck ms.
+# Without --gpu nothing is mined; only work delivery is measured.
+#
+# Usage: scripts/node-test.sh [--build <dir>] [--mode notify|longpoll|poll] [--duration <s>] [--gpu] [-- <mockpool options>]
+
+set -e
+
+BUILD=build
+MODE=notify
+DURATION=60
+GPU=
+NODE_PORT=8545
+
+while [ $# -gt 0 ]; do
+    case $1 in
+        --build) BUILD=$2; shift 2 ;;
+        --mode) MODE=$2; shift 2 ;;
+        --duration) DURATION=$2; shift 2 ;;
+        --gpu) GPU=-G; shift ;;
+        --) shift; break ;;
+        *) echo "Unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+ETHMINER=$BUILD/ethminer/ethminer
+MOCKPOOL=$BUILD/mockpool/mockpool
+LOG=$(mktemp -d)
+IPC=$LOG/node.ipc
+
+case $MODE in
+    notify) NODE_OPTIONS="--ipc $IPC"; MINER_OPTIONS="--farm-notify $IPC" ;;
+    longpoll) NODE_OPTIONS=; MINER_OPTIONS= ;;
+    poll) NODE_OPTIONS=--no-await; MINER_OPTIONS= ;;
+    *) echo "Unknown mode: $MODE" >&2; exit 1 ;;
+esac
+
+"$MOCKPOOL" --node $NODE_PORT $NODE_OPTIONS --duration "$DURATION" --job-interval 2000 "$@" > "$LOG/report.txt" 2> "$LOG/mockpool.log" &
+NODE=$!
+# The node builds its light cache before it listens.
+while kill -0 $NODE 2> /dev/null && ! grep -q "listening" "$LOG/mockpool.log"; do
+    sleep 1
+done
+"$ETHMINER" $GPU -F http://127.0.0.1:$NODE_PORT $MINER_OPTIONS > "$LOG/ethminer.log" 2>&1 &
+MINER=$!
+
+wait $NODE || true
+kill -INT $MINER 2> /dev/null || true
+wait $MINER || true
+
+cat "$LOG/report.txt"
+echo "Logs are in $LOG"
@@ -0,0 +1,63 @@
+#!/usr/bin/env sh
+
+# This script runs ethminer against the mock pool on loopback and prints what
+# was measured: how long jobs take to reach the miners, share round trips,
+# stale and rejected shares, and ethminer's own pool latencies.
+#
+# Without a GPU ethminer runs as a stratum proxy (--proxy) and the mock pool's
+# CPU rigs mine through it, which exercises the stratum client end to end.
+# With --gpu ethminer mines on the pool itself.
+#
+# Usage: scripts/pool-test.sh [--build <dir>] [--protocol <n>] [--duration <s>] [--gpu] [-- <mockpool options>]
+
+set -e
+
+BUILD=build
+PROTOCOL=0
+DURATION=60
+GPU=
+POOL_PORT=3333
+PROXY_PORT=3334
+
+while [ $# -gt 0 ]; do
+    case $1 in
+        --build) BUILD=$2; shift 2 ;;
+        --protocol) PROTOCOL=$2; shift 2 ;;
+        --duration) DURATION=$2; shift 2 ;;
+        --gpu) GPU=1; shift ;;
+        --) shift; break ;;
+        *) echo "Unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+ETHMINER=$BUILD/ethminer/ethminer
+MOCKPOOL=$BUILD/mockpool/mockpool
+LOG=$(mktemp -d)
+
+if [ -n "$GPU" ]; then
+    "$MOCKPOOL" --port $POOL_PORT -SP "$PROTOCOL" --duration "$DURATION" "$@" > "$LOG/report.txt" 2> "$LOG/mockpool.log" &
+    POOL=$!
+    sleep 1
+    "$ETHMINER" -G -S 127.0.0.1:$POOL_PORT -SP "$PROTOCOL" -O mock.gpu:x > "$LOG/ethminer.log" 2>&1 &
+    MINER=$!
+else
+    if [ "$PROTOCOL" = 2 ]; then
+        echo "ethminer raises EthereumStratum difficulties to 0.0001, which is too hard for the CPU rigs;" >&2
+        echo "only job delivery is measured." >&2
+    fi
+    # The rigs evaluate one nonce per share at most, so any nonce has to do.
+    "$MOCKPOOL" --port $POOL_PORT -SP "$PROTOCOL" --duration "$DURATION" --difficulty 1e-10 --rigs 4 $PROXY_PORT "$@" > "$LOG/report.txt" 2> "$LOG/mockpool.log" &
+    POOL=$!
+    sleep 1
+    "$ETHMINER" -S 127.0.0.1:$POOL_PORT -SP "$PROTOCOL" -O mock.proxy:x --proxy 127.0.0.1:$PROXY_PORT > "$LOG/ethminer.log" 2>&1 &
+    MINER=$!
+fi
+
+wait $POOL || true
+kill -INT $MINER 2> /dev/null || true
+wait $MINER || true
+
+cat "$LOG/report.txt"
+echo "ethminer:"
+tr -d '\033' < "$LOG/ethminer.log" | sed 's/\[[0-9;]*m//g' | grep -E "latency:|health:" || true
+echo "Logs are in $LOG"